@@ -0,0 +1,80 @@
+#include <bits/stdc++.h>
+
+#include "ast_file.h"
+#include "tree_writer.h"
+
+using namespace std;
+using namespace xd;
+
+// Reads a .ast file through ast_file and draws its tree in the .vcps format,
+// so the dump of a reduced tree matches the .vcps written with it. Checks
+// on the way that every node's kids end where its subtree does.
+int main(int argc, char const *argv[])
+{
+    if(argc < 2) {
+        cout << "usage: ast_dump [ast_file] [output_file]";
+        return -1;
+    }
+    ast_file file;
+    if(!file.open(argv[1])) {
+        cout << file.get_error();
+        return -1;
+    }
+    ofstream output_file;
+    if(argc > 2) {
+        output_file.open(argv[2]);
+    }
+    ostream& output = argc > 2 ? output_file : cout;
+
+    bool consistent = true;
+    {
+        vcps_writer writer(output);
+        // pre-order walk, a close entry follows the kids of every node
+        struct entry {
+            size_t node;
+            bool close;
+        };
+        vector<entry> stack{{0, false}};
+        vector<size_t> kids;
+        while(!stack.empty()) {
+            entry top = stack.back();
+            stack.pop_back();
+            if(top.close) {
+                writer.close();
+                continue;
+            }
+            ast_record record = file.get_node(top.node);
+            if(top.node == 0) {
+                writer.root(file.get_value(top.node), record.kid_count);
+            } else {
+                writer.kid(file.get_value(top.node), record.kid_count);
+            }
+            if(record.kid_count == 0) {
+                continue;
+            }
+
+            kids.clear();
+            file.for_each_kid(top.node, [&](size_t kid) {
+                kids.push_back(kid);
+            });
+            if(kids.size() != record.kid_count || file.next_sibling(kids.back()) != file.next_sibling(top.node)) {
+                consistent = false;
+                break;
+            }
+            stack.push_back({top.node, true});
+            for(auto it = kids.rbegin(); it != kids.rend(); it++) {
+                stack.push_back({*it, false});
+            }
+        }
+        writer.finish();
+    }
+    if(!consistent) {
+        cout << "ast file: corrupt";
+        return -1;
+    }
+    if(!output) {
+        cout << "cannot write " << (argc > 2 ? argv[2] : "output");
+        return -1;
+    }
+    return 0;
+}
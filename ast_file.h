@@ -0,0 +1,252 @@
+#pragma once
+
+#include "utils.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+using namespace std;
+
+namespace xd {
+    // Binary AST (.ast): one tree in pre-order, readable in place.
+    //
+    // layout: header, then
+    //   name_offsets[S + 1] (uint32), names (padded to 4 bytes),
+    //   nodes[N] (ast_record), source (source_bytes)
+    // where S is the number of grammar symbols. The kids of a node follow it
+    // directly and its subtree takes subtree_size records, so node i's next
+    // sibling is i + subtree_size. offset and length give the node's span in
+    // source: the token for a terminal, first to last token for a
+    // non-terminal (empty if it derives none). Offsets are 32-bit, so the
+    // source and the node count must fit in 32 bits.
+    struct ast_record {
+        uint32_t symbol;
+        uint32_t kid_count;
+        uint32_t subtree_size;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    const uint32_t AST_MAGIC = 0x00545341U; // "AST\0"
+    const uint32_t AST_VERSION = 1;
+
+    struct ast_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t flags;
+        uint32_t terminal_count;
+        uint32_t symbol_count;
+        uint32_t node_count;
+        uint32_t name_bytes;
+        uint32_t reserved;
+        uint64_t source_bytes;
+        uint64_t source_hash;
+    };
+
+    // Takes the nodes of a tree in pre-order, with the same calls as
+    // vcps_writer, and writes the .ast file on finish().
+    class ast_writer {
+        struct open_node {
+            size_t index;
+            bool has_start;
+        };
+
+        ostream& os;
+        const symbol_table& symbols;
+        string_view source;
+        uint32_t flags;
+        vector<ast_record> records;
+        vector<open_node> open_nodes;
+        uint32_t last_end{};
+
+        void add(symbol_id symbol, string_view value, size_t n_kids) {
+            ast_record record{symbol, static_cast<uint32_t>(n_kids), 1, last_end, 0};
+            // terminal values are views into source
+            if(symbols.is_terminal(symbol) && value.data() >= source.data() && value.data() <= source.data() + source.size()) {
+                record.offset = static_cast<uint32_t>(value.data() - source.data());
+                record.length = static_cast<uint32_t>(value.size());
+                for(auto it = open_nodes.rbegin(); it != open_nodes.rend() && !it->has_start; it++) {
+                    records[it->index].offset = record.offset;
+                    it->has_start = true;
+                }
+                last_end = record.offset + record.length;
+            }
+            records.push_back(record);
+            if(n_kids != 0) {
+                open_nodes.push_back({records.size() - 1, false});
+            }
+        }
+
+        public:
+
+        // flags is stored as is, FLAG_REDUCED marks a reduced tree
+        static const uint32_t FLAG_REDUCED = 1;
+
+        ast_writer(ostream& os, const symbol_table& symbols, string_view source, uint32_t flags) :
+            os(os), symbols(symbols), source(source), flags(flags) {}
+
+        void root(symbol_id symbol, string_view value, size_t n_kids) {
+            add(symbol, value, n_kids);
+        }
+
+        void kid(symbol_id symbol, string_view value, size_t n_kids) {
+            add(symbol, value, n_kids);
+        }
+
+        void close() {
+            open_node node = open_nodes.back();
+            open_nodes.pop_back();
+            ast_record& record = records[node.index];
+            record.subtree_size = static_cast<uint32_t>(records.size() - node.index);
+            if(node.has_start) {
+                record.length = last_end - record.offset;
+            }
+        }
+
+        // false without writing anything when the tree does not fit the
+        // format, or when the stream fails
+        bool finish() {
+            if(source.size() > UINT32_MAX || records.size() > UINT32_MAX) {
+                return false;
+            }
+            const size_t symbol_count = symbols.get_terminal_count() + symbols.get_non_terminal_count();
+            vector<uint32_t> name_offsets{0};
+            string names;
+            for(symbol_id id = 0; id < symbol_count; id++) {
+                names += symbols.get_name(id);
+                name_offsets.push_back(static_cast<uint32_t>(names.size()));
+            }
+            uint32_t name_bytes = static_cast<uint32_t>(names.size());
+            names.resize((names.size() + 3) / 4 * 4, '\0');
+
+            ast_header head{};
+            head.magic = AST_MAGIC;
+            head.version = AST_VERSION;
+            head.flags = flags;
+            head.terminal_count = static_cast<uint32_t>(symbols.get_terminal_count());
+            head.symbol_count = static_cast<uint32_t>(symbol_count);
+            head.node_count = static_cast<uint32_t>(records.size());
+            head.name_bytes = name_bytes;
+            head.source_bytes = source.size();
+            head.source_hash = hash_bytes(source.data(), source.size());
+
+            os.write(reinterpret_cast<const char*>(&head), sizeof(head));
+            os.write(reinterpret_cast<const char*>(name_offsets.data()), static_cast<streamsize>(name_offsets.size() * sizeof(uint32_t)));
+            os.write(names.data(), static_cast<streamsize>(names.size()));
+            os.write(reinterpret_cast<const char*>(records.data()), static_cast<streamsize>(records.size() * sizeof(ast_record)));
+            os.write(source.data(), static_cast<streamsize>(source.size()));
+            return os.good();
+        }
+    };
+
+    // Read-only, memory mapped .ast file. open() checks the header and the
+    // section sizes only; nodes are read on access, so any subtree can be
+    // visited without loading the rest of the file.
+    class ast_file {
+        mapped_file file;
+        ast_header head{};
+        const char* name_offsets{};
+        const char* names{};
+        const char* nodes{};
+        string_view source;
+        string error;
+
+        uint32_t name_offset(size_t no) const {
+            uint32_t offset;
+            memcpy(&offset, name_offsets + no * sizeof(uint32_t), sizeof(offset));
+            return offset;
+        }
+
+        bool fail(const string& mes) {
+            error = "ast file: " + mes;
+            return false;
+        }
+
+        public:
+
+        bool open(const string& filename) {
+            if(!file.open(filename)) {
+                return fail("file not found");
+            }
+            if(file.size() < sizeof(ast_header)) {
+                return fail("truncated");
+            }
+            memcpy(&head, file.data(), sizeof(head));
+            if(head.magic != AST_MAGIC || head.version != AST_VERSION) {
+                return fail("unknown format");
+            }
+
+            const uint64_t name_words = (uint64_t(head.name_bytes) + 3) / 4;
+            const uint64_t expected = sizeof(ast_header) + (uint64_t(head.symbol_count) + 1) * sizeof(uint32_t)
+                + name_words * 4 + uint64_t(head.node_count) * sizeof(ast_record) + head.source_bytes;
+            if(head.terminal_count > head.symbol_count || head.node_count == 0 || file.size() != expected) {
+                return fail("corrupt");
+            }
+
+            name_offsets = file.data() + sizeof(ast_header);
+            names = name_offsets + (uint64_t(head.symbol_count) + 1) * sizeof(uint32_t);
+            nodes = names + name_words * 4;
+            source = string_view(nodes + uint64_t(head.node_count) * sizeof(ast_record), head.source_bytes);
+            if(name_offset(head.symbol_count) != head.name_bytes) {
+                return fail("corrupt");
+            }
+            return true;
+        }
+
+        size_t size() const {return head.node_count;}
+        uint32_t get_flags() const {return head.flags;}
+        string_view get_source() const {return source;}
+        uint64_t get_source_hash() const {return head.source_hash;}
+        const string& get_error() const {return error;}
+
+        // the root is node 0
+        ast_record get_node(size_t node) const {
+            ast_record record;
+            memcpy(&record, nodes + node * sizeof(ast_record), sizeof(record));
+            return record;
+        }
+
+        bool is_terminal(symbol_id symbol) const {return symbol < head.terminal_count;}
+
+        string_view get_name(symbol_id symbol) const {
+            if(symbol >= head.symbol_count) {
+                return {};
+            }
+            uint32_t begin = name_offset(symbol);
+            uint32_t end = name_offset(symbol + 1);
+            if(begin > end || end > head.name_bytes) {
+                return {};
+            }
+            return string_view(names + begin, end - begin);
+        }
+
+        // the lexeme of a terminal, the symbol name of a non-terminal, as in .vcps
+        string_view get_value(size_t node) const {
+            ast_record record = get_node(node);
+            if(!is_terminal(record.symbol)) {
+                return get_name(record.symbol);
+            }
+            if(uint64_t(record.offset) + record.length > source.size()) {
+                return {};
+            }
+            return source.substr(record.offset, record.length);
+        }
+
+        size_t next_sibling(size_t node) const {
+            return node + get_node(node).subtree_size;
+        }
+
+        // calls visit(kid) for every kid of node, in order
+        template<typename visit_t>
+        void for_each_kid(size_t node, visit_t visit) const {
+            ast_record record = get_node(node);
+            size_t kid = node + 1;
+            for(uint32_t no = 0; no < record.kid_count && kid < size(); no++) {
+                visit(kid);
+                kid = next_sibling(kid);
+            }
+        }
+    };
+}
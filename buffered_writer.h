@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <vector>
+
+using namespace std;
+
+namespace xd {
+    // Collects output in a buffer and hands it to the stream in large
+    // blocks. Flushes on destruction. Buffers are reused: a writer takes one
+    // left by a finished writer on the same thread and returns it at the
+    // end, so a thread keeps one buffer per writer it has open at once
+    // (three when emitting every format), however many inputs it writes. A
+    // buffer grows with the output up to about BLOCK_SIZE, small outputs
+    // never allocate a whole block.
+    class buffered_writer {
+        static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+        ostream& os;
+        string buffer;
+
+        static vector<string>& spare_buffers() {
+            thread_local vector<string> spares;
+            return spares;
+        }
+
+        public:
+
+        explicit buffered_writer(ostream& os) : os(os) {
+            vector<string>& spares = spare_buffers();
+            if(!spares.empty()) {
+                buffer = std::move(spares.back());
+                spares.pop_back();
+            }
+        }
+
+        buffered_writer(const buffered_writer&) = delete;
+        buffered_writer& operator=(const buffered_writer&) = delete;
+
+        ~buffered_writer() {
+            flush();
+            spare_buffers().push_back(std::move(buffer));
+        }
+
+        buffered_writer& operator<<(string_view text) {
+            buffer.append(text.data(), text.size());
+            if(buffer.size() >= BLOCK_SIZE) {
+                flush();
+            }
+            return *this;
+        }
+
+        buffered_writer& operator<<(char c) {
+            buffer.push_back(c);
+            if(buffer.size() >= BLOCK_SIZE) {
+                flush();
+            }
+            return *this;
+        }
+
+        void flush() {
+            os.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    };
+}
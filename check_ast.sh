@@ -0,0 +1,70 @@
+#!/bin/sh
+# Check for the binary tree format: writes sample.vc as .ast and .vcps,
+# reads the .ast back through ast_file (ast_dump) and compares the dump with
+# the .vcps, then checks that truncated files and bad headers are refused.
+#
+# usage: check_ast.sh [main_binary] [ast_dump_binary] [input_file] [grammar_file]
+# (defaults ./main, ./ast_dump, sample and grammar, files without extension)
+
+MAIN=${1:-./main}
+DUMP=${2:-./ast_dump}
+INPUT=${3:-sample}
+GRAMMAR=${4:-grammar}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+for binary in "$MAIN" "$DUMP"; do
+    if [ ! -x "$binary" ]; then
+        echo "check_ast: $binary not found, build it with make"
+        exit 1
+    fi
+done
+
+fail=0
+if ! "$MAIN" "$INPUT" "$DIR/out" "$GRAMMAR" --formats=reduced,ast > "$DIR/main.out" 2>&1; then
+    echo "FAIL main: $(cat "$DIR/main.out")"
+    exit 1
+fi
+if ! "$DUMP" "$DIR/out.ast" "$DIR/dump.vcps" > "$DIR/dump.out"; then
+    echo "FAIL dump: $(cat "$DIR/dump.out")"
+    fail=1
+elif ! cmp -s "$DIR/out.vcps" "$DIR/dump.vcps"; then
+    echo "FAIL dump of out.ast differs from out.vcps"
+    fail=1
+else
+    echo "ok $INPUT.ast reads back as $INPUT.vcps"
+fi
+
+# expect <name> <message>: ast_dump must refuse DIR/name with message
+expect() {
+    if "$DUMP" "$DIR/$1" > "$DIR/refused.out" 2>&1; then
+        echo "FAIL $1 was accepted"
+        fail=1
+    elif [ "$(cat "$DIR/refused.out")" != "$2" ]; then
+        echo "FAIL $1: $(cat "$DIR/refused.out"), expected $2"
+        fail=1
+    else
+        echo "ok $1: $2"
+    fi
+}
+
+size=$(wc -c < "$DIR/out.ast")
+head -c $((size - 1)) "$DIR/out.ast" > "$DIR/short_by_one.ast"
+expect short_by_one.ast "ast file: corrupt"
+head -c $((size / 2)) "$DIR/out.ast" > "$DIR/half.ast"
+expect half.ast "ast file: corrupt"
+head -c 16 "$DIR/out.ast" > "$DIR/header_only.ast"
+expect header_only.ast "ast file: truncated"
+{ cat "$DIR/out.ast"; printf 'x'; } > "$DIR/trailing_byte.ast"
+expect trailing_byte.ast "ast file: corrupt"
+
+# magic is bytes 0-3, version bytes 4-7
+{ printf 'XST\0'; tail -c +5 "$DIR/out.ast"; } > "$DIR/bad_magic.ast"
+expect bad_magic.ast "ast file: unknown format"
+{ head -c 4 "$DIR/out.ast"; printf '\377\0\0\0'; tail -c +9 "$DIR/out.ast"; } > "$DIR/bad_version.ast"
+expect bad_version.ast "ast file: unknown format"
+: > "$DIR/empty.ast"
+expect empty.ast "ast file: truncated"
+
+[ $fail -eq 0 ] && echo "check_ast: all checks passed"
+exit $fail
@@ -0,0 +1,111 @@
+#!/bin/sh
+# Check for --split: generates random VC programs and compares every output
+# (.vcps, _full.vcps, _bracket.vcps, messages, exit code) of a sequential
+# parse with --split at --jobs=1 and --jobs=4, also with --shape (which
+# falls back to a sequential parse) and --precedence. Programs carry '{' and
+# '}' inside string literals and comments, which the brace-depth split must
+# skip, and some have a syntax error inside a function, so one item fails
+# and the whole input is parsed again sequentially.
+#
+# usage: check_split.sh [main_binary] [grammar_file] [count]
+# (defaults ./main, grammar without .dat, 200 programs)
+
+MAIN=${1:-./main}
+GRAMMAR=${2:-grammar}
+COUNT=${3:-200}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+if [ ! -x "$MAIN" ]; then
+    echo "check_split: $MAIN not found, build it with make"
+    exit 1
+fi
+
+# gen <seed> > file: one random program
+gen() {
+    awk -v seed="$1" '
+    function pick(list,    parts, n) {
+        n = split(list, parts, "@")
+        return parts[int(rand() * n) + 1]
+    }
+    function atom(    unary) {
+        unary = rand() < 0.1 ? pick("-@!") : ""
+        return unary pick("x@y@z[1]@1@25@2.5@true@false@f(x, 1)@g()@\"{\"@\"}\"@\"} {\"@\"{{\"")
+    }
+    function expr(d) {
+        if(d > 3 || rand() < 0.3) return atom()
+        if(rand() < 0.2) return "(" expr(d + 1) ")"
+        return expr(d + 1) " " pick("+@-@*@/@<@>@<=@>=@==@!=@&&@||@=") " " expr(d + 1)
+    }
+    function block(d, indent,    s, n, i) {
+        s = "{" (rand() < 0.2 ? " // { opens\n" : "\n")
+        n = int(rand() * 4)
+        for(i = 0; i < n; i++) s = s item(d + 1, indent "  ")
+        return s indent "}" (rand() < 0.2 ? " // } closes" : "") "\n"
+    }
+    function stmt(d, indent,    r) {
+        r = rand()
+        if(d < 3 && r < 0.15) return indent "if (" expr(0) ") " block(d, indent) (rand() < 0.5 ? indent "else " block(d, indent) : "")
+        if(d < 3 && r < 0.25) return indent "while (" expr(0) ") " block(d, indent)
+        if(d < 3 && r < 0.32) return indent "for (x = 0; x < 3; x = x + 1) " block(d, indent)
+        if(d < 3 && r < 0.38) return indent block(d, indent)
+        if(r < 0.42) return indent "break;\n"
+        if(r < 0.46) return indent "return " expr(0) ";\n"
+        if(r < 0.50) return indent "continue; // }}\n"
+        return indent expr(0) ";\n"
+    }
+    function item(d, indent) {
+        if(rand() < 0.2) return indent pick("int@float@boolean") " q" int(rand() * 10) " = " expr(0) ", w[3];\n"
+        return stmt(d, indent)
+    }
+    BEGIN {
+        srand(seed)
+        functions = 1 + int(rand() * 6)
+        broken = rand() < 0.15 ? int(rand() * functions) : -1
+        for(n = 0; n < functions; n++) {
+            if(rand() < 0.3) printf "// function {%d}\n", n
+            printf "%s fn%d(%s) {\n", pick("int@void@float@boolean"), n, pick("@int x@int x, float y[]")
+            items = 1 + int(rand() * 6)
+            for(i = 0; i < items; i++) {
+                printf "%s", item(0, "  ")
+                if(n == broken && i == 0) printf "  x = ;\n"
+            }
+            printf "}\n"
+        }
+    }'
+}
+
+# compare <name> <flags>: sequential parse against --split --jobs=1 and 4
+compare() {
+    name=$1; shift
+    "$MAIN" "$DIR/$name" "$DIR/seq" "$GRAMMAR" "$@" > "$DIR/seq.msg" 2>&1
+    echo $? > "$DIR/seq.rc"
+    for jobs in 1 4; do
+        "$MAIN" "$DIR/$name" "$DIR/split" "$GRAMMAR" "$@" --split --jobs=$jobs > "$DIR/split.msg" 2>&1
+        echo $? > "$DIR/split.rc"
+        for suffix in .vcps _full.vcps _bracket.vcps .msg .rc; do
+            if [ -f "$DIR/seq$suffix" ] && ! cmp -s "$DIR/seq$suffix" "$DIR/split$suffix"; then
+                echo "FAIL $name $* --split --jobs=$jobs: $suffix differs"
+                fail=1
+            fi
+        done
+        rm -f "$DIR"/split*
+    done
+    rm -f "$DIR"/seq*
+}
+
+fail=0
+failed_items=0
+seed=1
+while [ $seed -le "$COUNT" ]; do
+    gen $seed > "$DIR/p$seed.vc"
+    grep -q "x = ;" "$DIR/p$seed.vc" && failed_items=$((failed_items + 1))
+    compare p$seed
+    compare p$seed --shape
+    compare p$seed --precedence
+    rm -f "$DIR/p$seed.vc"
+    seed=$((seed + 1))
+done
+
+[ $fail -eq 0 ] && echo "check_split: $COUNT programs ($failed_items with a failing item) match the sequential parse"
+exit $fail
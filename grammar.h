@@ -1,31 +1,118 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
 #include <fstream>
 #include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+
+#include "mapped_file.h"
 
 using namespace std;
 
 namespace xd {
     const string EPSILON = "EPSILON";
+    const string STRING_ENDMARKER = "__$__";
+    const string STRING_EOF = "__EOF__";
+    const string STRING_ERROR = "__ERROR__";
+    const string STRING_COMMENT = "__COMMENT__";
 
     using vs = vector<string>;
 
+    using symbol_id = unsigned int;
+    using vsym = vector<symbol_id>;
+
+    const symbol_id NO_SYMBOL = ~0U;
+
+    // Interns every grammar symbol as a compact id. Ids are laid out as
+    // [terminals..., end marker][non-terminals...][EPSILON, lexer markers...]
+    // so classification is a range check.
+    class symbol_table {
+        vs names;
+        // keys view into names, so lookups by string_view never allocate
+        unordered_map<string_view, symbol_id> ids;
+        symbol_id terminal_count{};
+        symbol_id non_terminal_count{};
+
+        void reindex() {
+            ids.clear();
+            for(symbol_id id = 0; id < names.size(); id++) {
+                ids.emplace(names[id], id);
+            }
+        }
+
+        public:
+        symbol_table() = default;
+        symbol_table(const vs& terminals, const vs& non_terminals) {
+            names = terminals;
+            names.push_back(STRING_ENDMARKER);
+            terminal_count = static_cast<symbol_id>(names.size());
+
+            names.insert(names.end(), non_terminals.begin(), non_terminals.end());
+            non_terminal_count = static_cast<symbol_id>(names.size()) - terminal_count;
+
+            names.insert(names.end(), {EPSILON, STRING_EOF, STRING_ERROR, STRING_COMMENT});
+            reindex();
+        }
+
+        symbol_table(const symbol_table& other) :
+            names(other.names), terminal_count(other.terminal_count), non_terminal_count(other.non_terminal_count) {
+            reindex();
+        }
+
+        symbol_table& operator=(const symbol_table& other) {
+            if(this != &other) {
+                names = other.names;
+                terminal_count = other.terminal_count;
+                non_terminal_count = other.non_terminal_count;
+                reindex();
+            }
+            return *this;
+        }
+
+        symbol_table(symbol_table&&) = default;
+        symbol_table& operator=(symbol_table&&) = default;
+
+        symbol_id get_id(string_view name) const {
+            auto it = ids.find(name);
+            return it == ids.end() ? NO_SYMBOL : it->second;
+        }
+
+        const string& get_name(symbol_id id) const {return names[id];}
+
+        bool is_terminal(symbol_id id) const {return id < terminal_count;}
+        bool is_non_terminal(symbol_id id) const {return id >= terminal_count && id < terminal_count + non_terminal_count;}
+
+        // row of a non-terminal in tables indexed by non-terminal only
+        size_t non_terminal_no(symbol_id id) const {return id - terminal_count;}
+
+        size_t get_terminal_count() const {return terminal_count;}
+        size_t get_non_terminal_count() const {return non_terminal_count;}
+        size_t size() const {return names.size();}
+
+        symbol_id get_endmarker() const {return terminal_count - 1;}
+        symbol_id get_epsilon() const {return terminal_count + non_terminal_count;}
+        symbol_id get_eof() const {return get_epsilon() + 1;}
+        symbol_id get_error() const {return get_epsilon() + 2;}
+        symbol_id get_comment() const {return get_epsilon() + 3;}
+    };
+
     class rule {
-        vs entities;
+        vsym entities;
 
         public:
-        rule(const vs& entities) : entities(std::move(entities)) {}
+        rule(const vsym& entities) : entities(std::move(entities)) {}
         rule() = default;
 
-        const vs& get_entities() const {
+        const vsym& get_entities() const {
             return entities;
         }
 
-        void set_entities(const vs& entities) {
+        void set_entities(const vsym& entities) {
             this->entities = entities;
         }
 
@@ -47,10 +134,10 @@ namespace xd {
     using vrule = vector<rule>;
 
     class production{
-        string parent;
+        symbol_id parent{NO_SYMBOL};
         vrule rules;
         public:
-        production(string parent, vrule rules) : parent(std::move(parent)), rules(std::move(rules)) {}
+        production(symbol_id parent, vrule rules) : parent(parent), rules(std::move(rules)) {}
         production() = default;
 
         const vrule& get_rules() const {
@@ -61,25 +148,185 @@ namespace xd {
             this->rules = rules;
         }
 
-        const string get_parent() const {
+        symbol_id get_parent() const {
             return parent;
         }
 
-        void set_parent(const string& parent) {
+        void set_parent(symbol_id parent) {
             this->parent = parent;
         }
     };
 
     using vprod = vector<production>;
 
+    // one level of binary operators, symbol labels the nodes it builds
+    struct precedence_level {
+        symbol_id symbol{NO_SYMBOL};
+        bool right_assoc{};
+        vsym operators;
+    };
+
+    // Binary operator levels of a PRECEDENCE block, lowest first. The parser
+    // can hand the entry symbol over to an operator precedence parser that
+    // reads every operand as the operand symbol with the LL(1) table.
+    class operator_precedence {
+        symbol_id entry{NO_SYMBOL};
+        symbol_id operand{NO_SYMBOL};
+        vector<precedence_level> levels;
+        // level of every terminal, NO_LEVEL for non-operators
+        vector<uint32_t> level_of;
+
+        public:
+
+        static constexpr uint32_t NO_LEVEL = ~0U;
+
+        operator_precedence() = default;
+
+        operator_precedence(symbol_id entry, symbol_id operand, vector<precedence_level> levels, size_t terminal_count) :
+            entry(entry), operand(operand), levels(std::move(levels)), level_of(terminal_count, NO_LEVEL) {
+            for(uint32_t level = 0; level < this->levels.size(); level++) {
+                for(symbol_id op : this->levels[level].operators) {
+                    level_of[op] = level;
+                }
+            }
+        }
+
+        bool empty() const {return levels.empty();}
+        symbol_id get_entry() const {return entry;}
+        symbol_id get_operand() const {return operand;}
+        const vector<precedence_level>& get_levels() const {return levels;}
+
+        uint32_t get_level(symbol_id terminal) const {
+            return terminal < level_of.size() ? level_of[terminal] : NO_LEVEL;
+        }
+    };
+
+    // Tree-shape directives of a SHAPE block, applied while the tree is
+    // built: inline (the symbol's kids take its place in the parent),
+    // flatten (inline where the nearest enclosing node has the same symbol,
+    // so a recursive list is one node), drop (matched terminals are left
+    // out) and keep (never collapsed by the reduced views).
+    class tree_shape {
+        // per symbol, empty without a SHAPE block
+        vector<uint8_t> flags;
+
+        public:
+
+        enum : uint8_t {INLINE = 1, FLATTEN = 2, DROP = 4, KEEP = 8};
+
+        tree_shape() = default;
+        explicit tree_shape(vector<uint8_t> flags) : flags(std::move(flags)) {}
+
+        bool empty() const {return flags.empty();}
+        const vector<uint8_t>& get_flags() const {return flags;}
+
+        bool has(symbol_id symbol, uint8_t flag) const {
+            return symbol < flags.size() && (flags[symbol] & flag) != 0;
+        }
+    };
+
     class grammar_parser {
-        ifstream ifs;
+        string filename;
         vs terminals;
         vs non_terminals;
         string start_symbol;
+        symbol_table symbols;
         vprod grammar;
+        // lines of the PRECEDENCE block, resolved once symbols are known
+        vector<vs> precedence_lines;
+        operator_precedence precedence;
+        // lines of the SHAPE block, "directive symbol..."
+        vector<vs> shape_lines;
+        tree_shape shape;
         string error;
 
+        // <entry> <operand>, then one "left|right <symbol> operator..."
+        // line per level
+        bool build_precedence() {
+            if(precedence_lines.empty()) {
+                return true;
+            }
+            const vs& head = precedence_lines[0];
+            if(head.size() != 2 || !symbols.is_non_terminal(symbols.get_id(head[0])) ||
+               !symbols.is_non_terminal(symbols.get_id(head[1]))) {
+                set_error("precedence: <entry> <operand> non-terminals expected");
+                return false;
+            }
+
+            vector<precedence_level> levels;
+            unordered_set<symbol_id> seen;
+            for(size_t line_no = 1; line_no < precedence_lines.size(); line_no++) {
+                const vs& line = precedence_lines[line_no];
+                if(line.size() < 3 || (line[0] != "left" && line[0] != "right")) {
+                    set_error("precedence: left|right <symbol> operator... expected");
+                    return false;
+                }
+                precedence_level level;
+                level.right_assoc = line[0] == "right";
+                level.symbol = symbols.get_id(line[1]);
+                if(!symbols.is_non_terminal(level.symbol)) {
+                    set_error("precedence: non-terminal expected: " + line[1]);
+                    return false;
+                }
+                for(size_t no = 2; no < line.size(); no++) {
+                    symbol_id op = symbols.get_id(line[no]);
+                    if(!symbols.is_terminal(op) || op == symbols.get_endmarker() || !seen.insert(op).second) {
+                        set_error("precedence: invalid or duplicate operator: " + line[no]);
+                        return false;
+                    }
+                    level.operators.push_back(op);
+                }
+                levels.push_back(level);
+            }
+            if(levels.empty()) {
+                set_error("precedence: no operator levels");
+                return false;
+            }
+            precedence = operator_precedence(symbols.get_id(head[0]), symbols.get_id(head[1]), levels, symbols.get_terminal_count());
+            return true;
+        }
+
+        bool build_shape() {
+            if(shape_lines.empty()) {
+                return true;
+            }
+            const unordered_map<string, uint8_t> directives{
+                {"inline", tree_shape::INLINE}, {"flatten", tree_shape::FLATTEN},
+                {"drop", tree_shape::DROP}, {"keep", tree_shape::KEEP}};
+            vector<uint8_t> flags(symbols.get_terminal_count() + symbols.get_non_terminal_count());
+            for(const vs& line : shape_lines) {
+                auto directive = directives.find(line[0]);
+                if(directive == directives.end() || line.size() < 2) {
+                    set_error("shape: inline|flatten|drop|keep symbol... expected");
+                    return false;
+                }
+                for(size_t no = 1; no < line.size(); no++) {
+                    symbol_id symbol = symbols.get_id(line[no]);
+                    bool valid = directive->second == tree_shape::DROP
+                        ? symbols.is_terminal(symbol) && symbol != symbols.get_endmarker()
+                        : symbols.is_non_terminal(symbol);
+                    if(!valid) {
+                        set_error("shape: invalid symbol for " + line[0] + ": " + line[no]);
+                        return false;
+                    }
+                    flags[symbol] |= directive->second;
+                }
+            }
+            for(symbol_id symbol = 0; symbol < flags.size(); symbol++) {
+                if((flags[symbol] & tree_shape::INLINE) && (flags[symbol] & (tree_shape::KEEP | tree_shape::FLATTEN))) {
+                    set_error("shape: inline conflicts with keep or flatten: " + symbols.get_name(symbol));
+                    return false;
+                }
+            }
+            // the root has no parent to take its kids
+            if(flags[symbols.get_id(start_symbol)] & tree_shape::INLINE) {
+                set_error("shape: the start symbol cannot be inlined");
+                return false;
+            }
+            shape = tree_shape(std::move(flags));
+            return true;
+        }
+
         static vs split_tok(const string& str) {
             stringstream ss(str);
             string s;
@@ -91,205 +338,245 @@ namespace xd {
         }
 
         public:
-        grammar_parser(const string& filename) : ifs(filename) {}
-        ~grammar_parser() {
-            if(ifs.is_open()) {
-                ifs.close();
+        grammar_parser() = default;
+        grammar_parser(const string& filename) : filename(filename) {}
+
+        // reads the file given to the constructor
+        bool parse() {
+            mapped_file file(filename);
+            if(!file.is_open()) {
+                error = "grammar: file not found";
+                return false;
             }
+            return parse(file.view());
         }
 
-        bool parse() {
-            enum parse_state {NON, TERMINAL, NON_TERMINAL, START, RULES};
+        // parses grammar text held by the caller, line by line as in a file
+        bool parse(string_view text) {
+            enum parse_state {NON, TERMINAL, NON_TERMINAL, START, RULES, PRECEDENCE, SHAPE};
             enum rule_state {LEFT, COLON, ENTITY};
 
-            if(ifs.is_open()) {
-                parse_state parse_state_now = NON;
-                string line;
+            parse_state parse_state_now = NON;
+            size_t line_begin = 0;
 
-                unordered_map<string, vector<vs>> _grammar;
+            vector<pair<string, vector<vs>>> _grammar;
+            unordered_map<string, size_t> _grammar_index;
 
-                while(getline(ifs, line)) {
-                    if(line.size() == 0 || line[0] == '#') continue;
-                    
-                    vs tokens = split_tok(line);
+            while(line_begin < text.size()) {
+                size_t line_end = min(text.find('\n', line_begin), text.size());
+                string line(text.substr(line_begin, line_end - line_begin));
+                line_begin = line_end + 1;
+                if(line.size() == 0 || line[0] == '#') continue;
+                
+                vs tokens = split_tok(line);
 
-                    if(tokens[0] == "NON_TERMINAL") {
-                        if(parse_state_now != NON || tokens.size() > 1) {
-                            set_error("invalid token NON_TERMINAL");
-                            return false;
-                        }
-                        tokens.pop_back();
-                        parse_state_now = NON_TERMINAL;
-                    } else if(tokens[0] == "TERMINAL") {
-                        if(parse_state_now != NON || tokens.size() > 1) {
-                            set_error("invalid token TERMINAL");
-                            return false;
-                        }
-                        tokens.pop_back();
-                        parse_state_now = TERMINAL;
-                    } else if(tokens[0] == "START") {
-                        if(parse_state_now != NON || tokens.size() > 1) {
-                            set_error("invalid token START");
+                if(tokens[0] == "NON_TERMINAL") {
+                    if(parse_state_now != NON || tokens.size() > 1) {
+                        set_error("invalid token NON_TERMINAL");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = NON_TERMINAL;
+                } else if(tokens[0] == "TERMINAL") {
+                    if(parse_state_now != NON || tokens.size() > 1) {
+                        set_error("invalid token TERMINAL");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = TERMINAL;
+                } else if(tokens[0] == "START") {
+                    if(parse_state_now != NON || tokens.size() > 1) {
+                        set_error("invalid token START");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = START;
+                } else if(tokens[0] == "RULES") {
+                    if(parse_state_now != NON || tokens.size() > 1) {
+                        set_error("invalid token RULES");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = RULES;
+                } else if(tokens[0] == "PRECEDENCE") {
+                    if(parse_state_now != NON || tokens.size() > 1 || !precedence_lines.empty()) {
+                        set_error("invalid token PRECEDENCE");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = PRECEDENCE;
+                } else if(tokens[0] == "SHAPE") {
+                    if(parse_state_now != NON || tokens.size() > 1 || !shape_lines.empty()) {
+                        set_error("invalid token SHAPE");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = SHAPE;
+                } else if(tokens[0] == "END") {
+                    if(parse_state_now == NON || tokens.size() > 1) {
+                        set_error("invalid token END");
+                        return false;
+                    }
+                    tokens.pop_back();
+                    parse_state_now = NON;
+                }
+
+                if(parse_state_now == PRECEDENCE || parse_state_now == SHAPE) {
+                    if(!tokens.empty()) {
+                        (parse_state_now == SHAPE ? shape_lines : precedence_lines).push_back(tokens);
+                    }
+                    continue;
+                }
+
+                rule_state rule_state_now = LEFT;
+                string rule_parent;
+                vs rule_entities;
+
+                for(auto token : tokens) {
+                    switch (parse_state_now)
+                    {
+                    case NON:
+                        set_error("invalid token" + token);
+                        return false;
+                        break;
+
+                    case TERMINAL:
+                        if(token == EPSILON) {
+                            set_error("EPSILON is reserved");
                             return false;
                         }
-                        tokens.pop_back();
-                        parse_state_now = START;
-                    } else if(tokens[0] == "RULES") {
-                        if(parse_state_now != NON || tokens.size() > 1) {
-                            set_error("invalid token RULES");
+                        terminals.push_back(token);
+                        break;
+
+                    case NON_TERMINAL:
+                        if(token == EPSILON) {
+                            set_error("EPSILON is reserved");
                             return false;
                         }
-                        tokens.pop_back();
-                        parse_state_now = RULES;
-                    } else if(tokens[0] == "END") {
-                        if(parse_state_now == NON || tokens.size() > 1) {
-                            set_error("invalid token END");
+                        non_terminals.push_back(token);
+                        break;
+                    
+                    case START:
+                        if(!start_symbol.empty() || token == EPSILON) {
+                            set_error("ambiguous start symbol");
                             return false;
                         }
-                        tokens.pop_back();
-                        parse_state_now = NON;
-                    }
-
-                    rule_state rule_state_now = LEFT;
-                    string rule_parent;
-                    vs rule_entities;
-
-                    for(auto token : tokens) {
-                        switch (parse_state_now)
+                        start_symbol = token;
+                        break;
+                    
+                    case RULES:
+                        switch (rule_state_now)
                         {
-                        case NON:
-                            set_error("invalid token" + token);
-                            return false;
-                            break;
-
-                        case TERMINAL:
+                        case LEFT:
                             if(token == EPSILON) {
-                                set_error("EPSILON is reserved");
+                                set_error("production cannot start with EPSILON");
                                 return false;
                             }
-                            terminals.push_back(token);
+                            rule_parent = token;
+                            rule_state_now = COLON;
                             break;
 
-                        case NON_TERMINAL:
-                            if(token == EPSILON) {
-                                set_error("EPSILON is reserved");
+                        case COLON:
+                            if(token != ":") {
+                                set_error("rules syntax error ':' expected: " + token);
                                 return false;
                             }
-                            non_terminals.push_back(token);
+                            rule_state_now = ENTITY;
                             break;
                         
-                        case START:
-                            if(!start_symbol.empty() || token == EPSILON) {
-                                set_error("ambiguous start symbol");
-                                return false;
-                            }
-                            start_symbol = token;
-                            break;
-                        
-                        case RULES:
-                            switch (rule_state_now)
-                            {
-                            case LEFT:
-                                if(token == EPSILON) {
-                                    set_error("production cannot start with EPSILON");
-                                    return false;
-                                }
-                                rule_parent = token;
-                                rule_state_now = COLON;
-                                break;
-
-                            case COLON:
-                                if(token != ":") {
-                                    set_error("rules syntax error ':' expected: " + token);
-                                    return false;
-                                }
-                                rule_state_now = ENTITY;
-                                break;
-                            
-                            case ENTITY:
-                                rule_entities.push_back(token);
-                                break;
-
-                            default:
-                                break;
-                            }
+                        case ENTITY:
+                            rule_entities.push_back(token);
                             break;
 
                         default:
                             break;
                         }
+                        break;
+
+                    default:
+                        break;
                     }
+                }
 
-                    if(parse_state_now == RULES) {
-                        if(rule_state_now == ENTITY) {
-                            _grammar[rule_parent].push_back(rule_entities);
-                        } else if(rule_state_now == COLON) {
-                            set_error("rules syntax error ':' expected");
-                            return false;
+                if(parse_state_now == RULES) {
+                    if(rule_state_now == ENTITY) {
+                        auto it = _grammar_index.emplace(rule_parent, _grammar.size()).first;
+                        if(it->second == _grammar.size()) {
+                            _grammar.emplace_back(rule_parent, vector<vs>{});
                         }
+                        _grammar[it->second].second.push_back(rule_entities);
+                    } else if(rule_state_now == COLON) {
+                        set_error("rules syntax error ':' expected");
+                        return false;
                     }
                 }
+            }
 
-                if (parse_state_now != NON) {
-                    set_error("block is incomplete 'END' expected");
-                    return false;
-                }
+            if (parse_state_now != NON) {
+                set_error("block is incomplete 'END' expected");
+                return false;
+            }
 
-                unordered_set<string> _terminals(terminals.begin(), terminals.end()), 
-                                _non_terminals(non_terminals.begin(), non_terminals.end());
-                
-                if(_terminals.size() != terminals.size()) {
-                    set_error("inconsistent or duplicate terminals");
-                    return false;
-                }
+            unordered_set<string> _terminals(terminals.begin(), terminals.end()), 
+                            _non_terminals(non_terminals.begin(), non_terminals.end());
+            
+            if(_terminals.size() != terminals.size()) {
+                set_error("inconsistent or duplicate terminals");
+                return false;
+            }
 
-                if(_non_terminals.size() != non_terminals.size()) {
-                    set_error("inconsistent or duplicate non-terminals");
-                    return false;
-                }
-                for(const auto& terminal : _terminals) {
-                    for(const auto& non_terminal : _non_terminals) {
-                        if(terminal == non_terminal) {
-                            set_error("terminals and non_terminals not disjoint");
-                            return false;
-                        }
+            if(_non_terminals.size() != non_terminals.size()) {
+                set_error("inconsistent or duplicate non-terminals");
+                return false;
+            }
+            for(const auto& terminal : _terminals) {
+                for(const auto& non_terminal : _non_terminals) {
+                    if(terminal == non_terminal) {
+                        set_error("terminals and non_terminals not disjoint");
+                        return false;
                     }
                 }
+            }
 
-                for(const auto& _prod : _grammar) {
-                    production prod;
-                    if(_non_terminals.find(_prod.first) == _non_terminals.end()) {
-                        set_error("non-terminal not found:" + _prod.first);
-                        return false;
-                    }
+            symbols = symbol_table(terminals, non_terminals);
 
-                    prod.set_parent(_prod.first);
+            if(!symbols.is_non_terminal(symbols.get_id(start_symbol))) {
+                set_error("start symbol is not a non-terminal: " + start_symbol);
+                return false;
+            }
 
-                    vrule rules;
-                    for(const auto& _rule : _prod.second) {
-                        rule prod_rule;
-                        for (const auto& entity: _rule) {
-                            if(_non_terminals.find(entity) == _non_terminals.end() &&
-                            _terminals.find(entity) == _terminals.end() &&
-                            entity != EPSILON) {
-                                set_error("rule token is not defined: " + entity);
-                                return false;
-                            }
+            for(const auto& _prod : _grammar) {
+                production prod;
+                if(_non_terminals.find(_prod.first) == _non_terminals.end()) {
+                    set_error("non-terminal not found:" + _prod.first);
+                    return false;
+                }
+
+                prod.set_parent(symbols.get_id(_prod.first));
+
+                vrule rules;
+                for(const auto& _rule : _prod.second) {
+                    rule prod_rule;
+                    vsym entities;
+                    for (const auto& entity: _rule) {
+                        if(_non_terminals.find(entity) == _non_terminals.end() &&
+                        _terminals.find(entity) == _terminals.end() &&
+                        entity != EPSILON) {
+                            set_error("rule token is not defined: " + entity);
+                            return false;
                         }
-                        prod_rule.set_entities(_rule);
-                        rules.push_back(prod_rule);
+                        entities.push_back(symbols.get_id(entity));
                     }
-
-                    prod.set_rules(rules);
-
-                    grammar.push_back(prod);
+                    prod_rule.set_entities(entities);
+                    rules.push_back(prod_rule);
                 }
 
-                return true;
-            } else {
-                error = "grammar: file not found";
-                return false;
+                prod.set_rules(rules);
+
+                grammar.push_back(prod);
             }
+
+            return build_precedence() && build_shape();
         }
 
         void set_error(string mes) {
@@ -308,10 +595,24 @@ namespace xd {
             return start_symbol;
         };
 
+        const symbol_table& get_symbols() {
+            return symbols;
+        };
+
         const vprod& get_grammar() {
             return grammar;
         };
 
+        // empty unless the grammar has a PRECEDENCE block
+        const operator_precedence& get_precedence() {
+            return precedence;
+        };
+
+        // empty unless the grammar has a SHAPE block
+        const tree_shape& get_shape() {
+            return shape;
+        };
+
         const string& get_error() {
             return error;
         };
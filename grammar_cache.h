@@ -0,0 +1,333 @@
+#pragma once
+
+#include "parsing_table.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace std;
+
+namespace xd {
+    // Precompiled grammar (.ll1): the symbol table, the productions, the
+    // dense parsing table, the operator precedence and the tree shape of one
+    // grammar source, keyed by the source hash.
+    //
+    // layout: header, then native-endian uint32 sections
+    //   name_offsets[S + 1], names (padded to 4 bytes), prod_parent[P],
+    //   prod_rule_begin[P + 1], rule_entity_begin[R + 1], entities[E],
+    //   table[non_terminal_count * terminal_count],
+    //   precedence_entry, precedence_operand, level_symbol[L],
+    //   level_right_assoc[L], level_operator_begin[L + 1], operators[O],
+    //   shape_flags[F]
+    // where S = terminal_count + non_terminal_count and F is S or 0.
+    class grammar_cache {
+        static const uint32_t MAGIC = 0x00314C4CU; // "LL1\0"
+        static const uint32_t VERSION = 3;
+
+        struct header {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t source_hash;
+            uint64_t payload_hash;
+            uint32_t terminal_count;
+            uint32_t non_terminal_count;
+            uint32_t start_symbol;
+            uint32_t production_count;
+            uint32_t rule_count;
+            uint32_t entity_count;
+            uint32_t name_bytes;
+            uint32_t level_count;
+            uint32_t operator_count;
+            uint32_t shape_count;
+        };
+
+        symbol_table symbols;
+        vprod productions;
+        table table_;
+        operator_precedence precedence;
+        tree_shape shape;
+        symbol_id start_symbol{NO_SYMBOL};
+        string error;
+
+        static void put(string& out, uint32_t value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        static void put(string& out, const vector<uint32_t>& values) {
+            out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(uint32_t));
+        }
+
+        static vector<uint32_t> take(const char*& cursor, size_t count) {
+            vector<uint32_t> values(count);
+            memcpy(values.data(), cursor, count * sizeof(uint32_t));
+            cursor += count * sizeof(uint32_t);
+            return values;
+        }
+
+        static bool ascending(const vector<uint32_t>& offsets, uint32_t last) {
+            if(offsets.empty() || offsets[0] != 0 || offsets.back() != last) {
+                return false;
+            }
+            for(size_t no = 1; no < offsets.size(); no++) {
+                if(offsets[no] < offsets[no - 1]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool fail(const string& mes) {
+            error = "grammar cache: " + mes;
+            return false;
+        }
+
+        public:
+
+        static uint64_t hash_source(string_view source) {
+            return hash_bytes(source.data(), source.size());
+        }
+
+        bool load(const string& filename, uint64_t source_hash) {
+            mapped_file file(filename);
+            if(!file.is_open()) {
+                return fail("file not found");
+            }
+
+            header head{};
+            if(file.size() < sizeof(header)) {
+                return fail("truncated");
+            }
+            memcpy(&head, file.data(), sizeof(header));
+
+            if(head.magic != MAGIC || head.version != VERSION) {
+                return fail("unknown format");
+            }
+
+            if(head.source_hash != source_hash) {
+                return fail("stale");
+            }
+
+            const uint64_t symbol_count = uint64_t(head.terminal_count) + head.non_terminal_count;
+            const uint64_t name_words = (uint64_t(head.name_bytes) + 3) / 4;
+            const uint64_t words = (symbol_count + 1) + name_words
+                + head.production_count + (uint64_t(head.production_count) + 1)
+                + (uint64_t(head.rule_count) + 1) + head.entity_count
+                + uint64_t(head.terminal_count) * head.non_terminal_count
+                + 2 + uint64_t(head.level_count) * 2 + (uint64_t(head.level_count) + 1) + head.operator_count
+                + head.shape_count;
+            if(head.terminal_count == 0 || (head.shape_count != 0 && head.shape_count != symbol_count) || file.size() != sizeof(header) + words * sizeof(uint32_t)) {
+                return fail("corrupt");
+            }
+
+            const char* cursor = file.data() + sizeof(header);
+            if(hash_bytes(cursor, file.size() - sizeof(header)) != head.payload_hash) {
+                return fail("corrupt");
+            }
+
+            vector<uint32_t> name_offsets = take(cursor, symbol_count + 1);
+            if(!ascending(name_offsets, head.name_bytes)) {
+                return fail("corrupt");
+            }
+
+            vs names;
+            for(size_t no = 0; no < symbol_count; no++) {
+                names.emplace_back(cursor + name_offsets[no], name_offsets[no + 1] - name_offsets[no]);
+            }
+            cursor += name_words * 4;
+
+            vs terminals(names.begin(), names.begin() + head.terminal_count - 1);
+            vs non_terminals(names.begin() + head.terminal_count, names.end());
+            symbols = symbol_table(terminals, non_terminals);
+            for(symbol_id id = 0; id < symbol_count; id++) {
+                if(symbols.get_id(names[id]) != id) {
+                    return fail("corrupt");
+                }
+            }
+
+            vector<uint32_t> parents = take(cursor, head.production_count);
+            vector<uint32_t> rule_begin = take(cursor, head.production_count + 1);
+            vector<uint32_t> entity_begin = take(cursor, head.rule_count + 1);
+            vector<uint32_t> entities = take(cursor, head.entity_count);
+            table_ = take(cursor, uint64_t(head.terminal_count) * head.non_terminal_count);
+            vector<uint32_t> precedence_symbols = take(cursor, 2);
+            vector<uint32_t> level_symbols = take(cursor, head.level_count);
+            vector<uint32_t> level_right_assoc = take(cursor, head.level_count);
+            vector<uint32_t> operator_begin = take(cursor, head.level_count + 1);
+            vector<uint32_t> operators = take(cursor, head.operator_count);
+            vector<uint32_t> shape_flags = take(cursor, head.shape_count);
+
+            if(!ascending(rule_begin, head.rule_count) || !ascending(entity_begin, head.entity_count)) {
+                return fail("corrupt");
+            }
+
+            productions.clear();
+            for(size_t prod_no = 0; prod_no < head.production_count; prod_no++) {
+                if(!symbols.is_non_terminal(parents[prod_no])) {
+                    return fail("corrupt");
+                }
+
+                vrule rules;
+                for(size_t rule_no = rule_begin[prod_no]; rule_no < rule_begin[prod_no + 1]; rule_no++) {
+                    vsym body(entities.begin() + entity_begin[rule_no], entities.begin() + entity_begin[rule_no + 1]);
+                    for(symbol_id entity : body) {
+                        if(entity >= symbol_count && entity != symbols.get_epsilon()) {
+                            return fail("corrupt");
+                        }
+                    }
+                    if(body.empty()) {
+                        return fail("corrupt");
+                    }
+                    rules.emplace_back(body);
+                }
+                productions.emplace_back(parents[prod_no], rules);
+            }
+
+            for(unsigned int entry : table_) {
+                if(entry == ERROR_ENTRY) {
+                    continue;
+                }
+                unsigned int prod_no = entry >> 16U;
+                unsigned int rule_no = entry ^ (prod_no << 16U);
+                if(prod_no >= productions.size() || rule_no >= productions[prod_no].get_rules().size()) {
+                    return fail("corrupt");
+                }
+            }
+
+            start_symbol = head.start_symbol;
+            if(!symbols.is_non_terminal(start_symbol)) {
+                return fail("corrupt");
+            }
+
+            precedence = operator_precedence();
+            if(head.level_count != 0) {
+                if(!symbols.is_non_terminal(precedence_symbols[0]) || !symbols.is_non_terminal(precedence_symbols[1]) ||
+                   !ascending(operator_begin, head.operator_count)) {
+                    return fail("corrupt");
+                }
+                vector<precedence_level> levels(head.level_count);
+                for(size_t level_no = 0; level_no < head.level_count; level_no++) {
+                    levels[level_no].symbol = level_symbols[level_no];
+                    levels[level_no].right_assoc = level_right_assoc[level_no] != 0;
+                    levels[level_no].operators.assign(operators.begin() + operator_begin[level_no], operators.begin() + operator_begin[level_no + 1]);
+                    if(!symbols.is_non_terminal(levels[level_no].symbol)) {
+                        return fail("corrupt");
+                    }
+                    for(symbol_id op : levels[level_no].operators) {
+                        if(!symbols.is_terminal(op)) {
+                            return fail("corrupt");
+                        }
+                    }
+                }
+                precedence = operator_precedence(precedence_symbols[0], precedence_symbols[1], std::move(levels), head.terminal_count);
+            }
+            shape = tree_shape(vector<uint8_t>(shape_flags.begin(), shape_flags.end()));
+
+            return true;
+        }
+
+        bool save(const string& filename, uint64_t source_hash, const parsing_table& parsing_table_, symbol_id start) {
+            const symbol_table& table_symbols = parsing_table_.get_symbols();
+            const vprod& prods = parsing_table_.get_productions();
+            const size_t symbol_count = table_symbols.get_terminal_count() + table_symbols.get_non_terminal_count();
+
+            vector<uint32_t> name_offsets{0};
+            string names;
+            for(symbol_id id = 0; id < symbol_count; id++) {
+                names += table_symbols.get_name(id);
+                name_offsets.push_back(static_cast<uint32_t>(names.size()));
+            }
+            uint32_t name_bytes = static_cast<uint32_t>(names.size());
+            names.resize((names.size() + 3) / 4 * 4, '\0');
+
+            vector<uint32_t> parents, rule_begin{0}, entity_begin{0}, entities;
+            for(const auto& prod : prods) {
+                parents.push_back(prod.get_parent());
+                for(const auto& prod_rule : prod.get_rules()) {
+                    entities.insert(entities.end(), prod_rule.get_entities().begin(), prod_rule.get_entities().end());
+                    entity_begin.push_back(static_cast<uint32_t>(entities.size()));
+                }
+                rule_begin.push_back(static_cast<uint32_t>(entity_begin.size() - 1));
+            }
+
+            const operator_precedence& precedence_ = parsing_table_.get_precedence();
+            vector<uint32_t> level_symbols, level_right_assoc, operator_begin{0}, operators;
+            for(const auto& level : precedence_.get_levels()) {
+                level_symbols.push_back(level.symbol);
+                level_right_assoc.push_back(level.right_assoc ? 1 : 0);
+                operators.insert(operators.end(), level.operators.begin(), level.operators.end());
+                operator_begin.push_back(static_cast<uint32_t>(operators.size()));
+            }
+
+            const vector<uint8_t>& shape_ = parsing_table_.get_shape().get_flags();
+            vector<uint32_t> shape_flags(shape_.begin(), shape_.end());
+
+            string payload;
+            put(payload, name_offsets);
+            payload += names;
+            put(payload, parents);
+            put(payload, rule_begin);
+            put(payload, entity_begin);
+            put(payload, entities);
+            put(payload, parsing_table_.get_table());
+            put(payload, precedence_.get_entry());
+            put(payload, precedence_.get_operand());
+            put(payload, level_symbols);
+            put(payload, level_right_assoc);
+            put(payload, operator_begin);
+            put(payload, operators);
+            put(payload, shape_flags);
+
+            header head{};
+            head.magic = MAGIC;
+            head.version = VERSION;
+            head.source_hash = source_hash;
+            head.payload_hash = hash_bytes(payload.data(), payload.size());
+            head.terminal_count = static_cast<uint32_t>(table_symbols.get_terminal_count());
+            head.non_terminal_count = static_cast<uint32_t>(table_symbols.get_non_terminal_count());
+            head.start_symbol = start;
+            head.production_count = static_cast<uint32_t>(prods.size());
+            head.rule_count = static_cast<uint32_t>(entity_begin.size() - 1);
+            head.entity_count = static_cast<uint32_t>(entities.size());
+            head.name_bytes = name_bytes;
+            head.level_count = static_cast<uint32_t>(level_symbols.size());
+            head.operator_count = static_cast<uint32_t>(operators.size());
+            head.shape_count = static_cast<uint32_t>(shape_flags.size());
+
+            // write beside the target and rename, so concurrent runs never read a partial file
+            string temp_filename = filename + ".tmp" + to_string(random_device{}());
+            {
+                ofstream ofs(temp_filename, ios::binary | ios::trunc);
+                if(!ofs.good()) {
+                    return fail("cannot write " + filename);
+                }
+                ofs.write(reinterpret_cast<const char*>(&head), sizeof(head));
+                ofs.write(payload.data(), static_cast<streamsize>(payload.size()));
+                if(!ofs.good()) {
+                    ofs.close();
+                    std::remove(temp_filename.c_str());
+                    return fail("cannot write " + filename);
+                }
+            }
+
+            if(std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+                std::remove(filename.c_str());
+                if(std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+                    std::remove(temp_filename.c_str());
+                    return fail("cannot write " + filename);
+                }
+            }
+            return true;
+        }
+
+        const symbol_table& get_symbols() const {return symbols;}
+        const vprod& get_productions() const {return productions;}
+        const table& get_table() const {return table_;}
+        const operator_precedence& get_precedence() const {return precedence;}
+        const tree_shape& get_shape() const {return shape;}
+        symbol_id get_start_symbol() const {return start_symbol;}
+        const string& get_error() const {return error;}
+    };
+}
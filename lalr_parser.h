@@ -0,0 +1,112 @@
+#pragma once
+
+#include "lalr_table.h"
+#include "lexer.h"
+#include "parsing_tree.h"
+#include <memory>
+
+using namespace std;
+
+namespace xd {
+    // Shift-reduce parser driven by a lalr_table. Each step shifts one token
+    // or reduces one rule; a reduction makes the node of the rule's parent
+    // from the nodes of its body, so the tree grows bottom-up and is the
+    // same derivation tree the LL(1) parser builds for the same grammar.
+    // The parse stops at the first error.
+    class lalr_parser {
+        string_view source;
+        vector<token_span> input_tokens;
+        size_t current_step{};
+        shared_ptr<const lalr_table> lalr_table_;
+        // states of the viable prefix, and the node of the symbol that
+        // entered each state but the first
+        vector<uint32_t> states;
+        vector<node_id> nodes;
+        parsing_tree ast;
+        vs errors;
+        bool done{true};
+
+        string error_message(symbol_id symbol) {
+            return "parser: error at symbol: " + lalr_table_->get_symbols().get_name(symbol);
+        }
+
+        void reduce(uint32_t rule_no) {
+            const symbol_table& symbols = lalr_table_->get_symbols();
+            const lr_rule& rule = lalr_table_->get_rule(rule_no);
+            node_id parent = ast.add_node(rule.parent, symbols.get_name(rule.parent), true);
+            size_t first = nodes.size() - rule.body.size();
+            if(rule.body.empty()) {
+                ast.add_kid(parent, symbols.get_epsilon(), symbols.get_name(symbols.get_epsilon()), true);
+            }
+            for(size_t no = first; no < nodes.size(); no++) {
+                ast.attach_kid(parent, nodes[no]);
+                if(!ast[nodes[no]].is_epsilon) {
+                    ast[parent].is_epsilon = false;
+                }
+            }
+            nodes.resize(first);
+            states.resize(states.size() - rule.body.size());
+            nodes.push_back(parent);
+            states.push_back(lalr_table_->get_goto(states.back(), rule.parent));
+        }
+
+        public:
+
+        lalr_parser() = default;
+
+        bool is_complete() const {return done;}
+
+        void parser_next_step() {
+            const symbol_table& symbols = lalr_table_->get_symbols();
+            symbol_id current_type = current_step < input_tokens.size() ? input_tokens[current_step].token_type : symbols.get_endmarker();
+            uint32_t action = lalr_table_->get_action(states.back(), current_type);
+            if(action == ERROR_ENTRY) {
+                errors.push_back(error_message(current_type));
+                done = true;
+            } else if(lalr_table::is_shift(action)) {
+                nodes.push_back(ast.add_node(current_type, input_tokens[current_step].value(source), false));
+                states.push_back(lalr_table::shifted_state(action));
+                current_step++;
+            } else if(lalr_table::reduced_rule(action) == 0) {
+                ast.set_root_node(nodes.back());
+                done = true;
+            } else {
+                reduce(lalr_table::reduced_rule(action));
+            }
+        }
+
+        // see parser::emit()
+        bool emit(ostream* full, ostream* reduced, ostream* bracket, ostream* binary = nullptr) const {
+            return ast.emit(lalr_table_->get_symbols(), source, full, reduced, bracket, binary);
+        }
+
+        const parsing_tree& get_tree() const {return ast;}
+
+        // hands the tree over, the parser needs restart() before the next parse
+        parsing_tree release_tree() {
+            return std::move(ast);
+        }
+
+        // spans into source, which must outlive the parser's use of the tree
+        void set_input(string_view source, vector<token_span> tokens) {
+            this->source = source;
+            input_tokens = std::move(tokens);
+        }
+
+        void restart() {
+            current_step = 0;
+            states.assign(1, 0);
+            nodes.clear();
+            errors.clear();
+            ast.clear();
+            ast.reserve(input_tokens.size() * 4 + 1);
+            done = false;
+        }
+
+        void set_lalr_table(shared_ptr<const lalr_table> table) {
+            lalr_table_ = std::move(table);
+        }
+
+        const vs& get_errors() const {return errors;}
+    };
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "parsing_table.h"
+#include <map>
+
+using namespace std;
+
+namespace xd {
+    // One rule as the LR automaton sees it: an EPSILON rule has an empty body.
+    // Rule 0 is the added start rule, reducing it accepts the input.
+    struct lr_rule {
+        symbol_id parent{NO_SYMBOL};
+        size_t prod_no{};
+        size_t rule_no{};
+        vsym body;
+    };
+
+    // LALR(1) tables of a grammar for a shift-reduce parser, in dense
+    // [state][terminal] action and [state][non_terminal_no] goto arrays.
+    // The LR(0) automaton is built first, then lookaheads are propagated
+    // between the kernel items of its states until nothing changes.
+    // Conflicts are kept in get_errors(), one message per cell, and resolved
+    // as shift over reduce and, between reductions, the item the closure
+    // reaches first, which is the derivation an LL(1) table picks.
+    class lalr_table {
+        // (rule << 32) | dot
+        using lr_item = uint64_t;
+
+        symbol_table symbols;
+        vprod productions;
+        nullables_table nullables;
+        symbols_table firsts;
+
+        vector<lr_rule> rules;
+        // rules of every symbol, only filled for non-terminals
+        vector<vector<uint32_t>> rules_of;
+        // FIRST of each rule body from each dot on, without EPSILON, and
+        // whether that rest of the body is nullable
+        vector<vector<symbol_set>> rest_firsts;
+        vector<vector<bool>> rest_nullable;
+
+        vector<vector<lr_item>> kernels;
+        vector<vector<symbol_set>> lookaheads;
+        vector<uint32_t> actions;
+        vector<uint32_t> gotos;
+        vs errors;
+
+        static lr_item make_item(uint32_t rule, uint32_t dot) {return (uint64_t(rule) << 32U) | dot;}
+        static uint32_t item_rule(lr_item item) {return static_cast<uint32_t>(item >> 32U);}
+        static uint32_t item_dot(lr_item item) {return static_cast<uint32_t>(item);}
+
+        string rule_name(uint32_t rule) const {
+            return symbols.get_name(rules[rule].parent);
+        }
+
+        void add_rules(symbol_id start_symbol) {
+            rules.clear();
+            rules_of.assign(symbols.size(), {});
+            rules.push_back({start_symbol, ~size_t(0), ~size_t(0), {start_symbol}});
+            for(size_t prod_no = 0; prod_no < productions.size(); prod_no++) {
+                symbol_id parent = productions[prod_no].get_parent();
+                const auto& prod_rules = productions[prod_no].get_rules();
+                for(size_t rule_no = 0; rule_no < prod_rules.size(); rule_no++) {
+                    lr_rule rule{parent, prod_no, rule_no, {}};
+                    for(symbol_id entity : prod_rules[rule_no].get_entities()) {
+                        if(entity != symbols.get_epsilon()) {
+                            rule.body.push_back(entity);
+                        }
+                    }
+                    rules_of[parent].push_back(static_cast<uint32_t>(rules.size()));
+                    rules.push_back(std::move(rule));
+                }
+            }
+
+            rest_firsts.assign(rules.size(), {});
+            rest_nullable.assign(rules.size(), {});
+            for(size_t rule_no = 0; rule_no < rules.size(); rule_no++) {
+                const vsym& body = rules[rule_no].body;
+                vector<symbol_set>& sets = rest_firsts[rule_no];
+                vector<bool>& nullable = rest_nullable[rule_no];
+                sets.assign(body.size() + 1, symbol_set(symbols.size()));
+                nullable.assign(body.size() + 1, true);
+                for(size_t dot = body.size(); dot-- > 0;) {
+                    symbol_id entity = body[dot];
+                    if(symbols.is_terminal(entity)) {
+                        sets[dot].set(entity);
+                        nullable[dot] = false;
+                        continue;
+                    }
+                    sets[dot].merge(firsts[entity]);
+                    sets[dot].reset(symbols.get_epsilon());
+                    if(nullables.test(entity)) {
+                        sets[dot].merge(sets[dot + 1]);
+                        nullable[dot] = nullable[dot + 1];
+                    } else {
+                        nullable[dot] = false;
+                    }
+                }
+            }
+        }
+
+        // items of a state, kernel first, then in the order the closure
+        // reaches them
+        vector<lr_item> closure(const vector<lr_item>& kernel) const {
+            vector<lr_item> items = kernel;
+            vector<bool> expanded(symbols.size(), false);
+            for(size_t no = 0; no < items.size(); no++) {
+                const vsym& body = rules[item_rule(items[no])].body;
+                uint32_t dot = item_dot(items[no]);
+                if(dot < body.size() && symbols.is_non_terminal(body[dot]) && !expanded[body[dot]]) {
+                    expanded[body[dot]] = true;
+                    for(uint32_t rule : rules_of[body[dot]]) {
+                        items.push_back(make_item(rule, 0));
+                    }
+                }
+            }
+            return items;
+        }
+
+        // LR(0) states and their shift and goto cells
+        void build_states() {
+            const size_t terminal_count = symbols.get_terminal_count();
+            const size_t non_terminal_count = symbols.get_non_terminal_count();
+            map<vector<lr_item>, uint32_t> state_of;
+            kernels.assign(1, {make_item(0, 0)});
+            state_of.emplace(kernels[0], 0);
+            actions.clear();
+            gotos.clear();
+
+            for(uint32_t state = 0; state < kernels.size(); state++) {
+                actions.resize(kernels.size() * terminal_count, ERROR_ENTRY);
+                gotos.resize(kernels.size() * non_terminal_count, ERROR_ENTRY);
+
+                // successor items grouped by the symbol after the dot
+                vector<pair<symbol_id, lr_item>> moves;
+                for(lr_item item : closure(kernels[state])) {
+                    const vsym& body = rules[item_rule(item)].body;
+                    if(item_dot(item) < body.size()) {
+                        moves.emplace_back(body[item_dot(item)], item + 1);
+                    }
+                }
+                sort(moves.begin(), moves.end());
+                moves.erase(unique(moves.begin(), moves.end()), moves.end());
+
+                for(size_t begin = 0; begin < moves.size();) {
+                    symbol_id symbol = moves[begin].first;
+                    vector<lr_item> kernel;
+                    size_t end = begin;
+                    for(; end < moves.size() && moves[end].first == symbol; end++) {
+                        kernel.push_back(moves[end].second);
+                    }
+                    begin = end;
+
+                    auto inserted = state_of.emplace(kernel, static_cast<uint32_t>(kernels.size()));
+                    if(inserted.second) {
+                        kernels.push_back(std::move(kernel));
+                    }
+                    uint32_t target = inserted.first->second;
+                    if(symbols.is_terminal(symbol)) {
+                        actions[state * terminal_count + symbol] = target << 1U;
+                    } else {
+                        gotos[state * non_terminal_count + symbols.non_terminal_no(symbol)] = target;
+                    }
+                }
+            }
+            actions.resize(kernels.size() * terminal_count, ERROR_ENTRY);
+            gotos.resize(kernels.size() * non_terminal_count, ERROR_ENTRY);
+        }
+
+        uint32_t successor(uint32_t state, symbol_id symbol) const {
+            if(symbols.is_terminal(symbol)) {
+                return get_action(state, symbol) >> 1U;
+            }
+            return get_goto(state, symbol);
+        }
+
+        // closure of a state with the lookaheads of its items
+        void closure(uint32_t state, vector<lr_item>& items, vector<symbol_set>& item_lookaheads) const {
+            items = kernels[state];
+            item_lookaheads = lookaheads[state];
+            // position of the dot 0 item of every rule in items
+            unordered_map<uint32_t, size_t> item_no;
+            vector<size_t> worklist(items.size());
+            for(size_t no = 0; no < items.size(); no++) {
+                worklist[no] = no;
+            }
+
+            for(size_t head = 0; head < worklist.size(); head++) {
+                size_t no = worklist[head];
+                uint32_t rule = item_rule(items[no]);
+                uint32_t dot = item_dot(items[no]);
+                const vsym& body = rules[rule].body;
+                if(dot == body.size() || !symbols.is_non_terminal(body[dot])) {
+                    continue;
+                }
+
+                symbol_set lookahead = rest_firsts[rule][dot + 1];
+                if(rest_nullable[rule][dot + 1]) {
+                    lookahead.merge(item_lookaheads[no]);
+                }
+                for(uint32_t expansion : rules_of[body[dot]]) {
+                    auto found = item_no.find(expansion);
+                    if(found == item_no.end()) {
+                        item_no.emplace(expansion, items.size());
+                        worklist.push_back(items.size());
+                        items.push_back(make_item(expansion, 0));
+                        item_lookaheads.push_back(lookahead);
+                    } else if(item_lookaheads[found->second].merge(lookahead)) {
+                        worklist.push_back(found->second);
+                    }
+                }
+            }
+        }
+
+        void build_lookaheads() {
+            lookaheads.assign(kernels.size(), {});
+            for(size_t state = 0; state < kernels.size(); state++) {
+                lookaheads[state].assign(kernels[state].size(), symbol_set(symbols.size()));
+            }
+            lookaheads[0][0].set(symbols.get_endmarker());
+
+            vector<uint32_t> worklist{0};
+            vector<bool> queued(kernels.size(), false);
+            queued[0] = true;
+            vector<lr_item> items;
+            vector<symbol_set> item_lookaheads;
+            while(!worklist.empty()) {
+                uint32_t state = worklist.back();
+                worklist.pop_back();
+                queued[state] = false;
+
+                closure(state, items, item_lookaheads);
+                for(size_t no = 0; no < items.size(); no++) {
+                    const vsym& body = rules[item_rule(items[no])].body;
+                    if(item_dot(items[no]) == body.size()) {
+                        continue;
+                    }
+                    uint32_t target = successor(state, body[item_dot(items[no])]);
+                    const vector<lr_item>& kernel = kernels[target];
+                    size_t kernel_no = lower_bound(kernel.begin(), kernel.end(), items[no] + 1) - kernel.begin();
+                    if(lookaheads[target][kernel_no].merge(item_lookaheads[no]) && !queued[target]) {
+                        worklist.push_back(target);
+                        queued[target] = true;
+                    }
+                }
+            }
+        }
+
+        void build_reductions() {
+            const size_t terminal_count = symbols.get_terminal_count();
+            vector<lr_item> items;
+            vector<symbol_set> item_lookaheads;
+            for(uint32_t state = 0; state < kernels.size(); state++) {
+                closure(state, items, item_lookaheads);
+                for(size_t no = 0; no < items.size(); no++) {
+                    uint32_t rule = item_rule(items[no]);
+                    if(item_dot(items[no]) != rules[rule].body.size()) {
+                        continue;
+                    }
+                    item_lookaheads[no].for_each([&](symbol_id symbol) {
+                        uint32_t& action = actions[state * terminal_count + symbol];
+                        if(action == ERROR_ENTRY) {
+                            action = (rule << 1U) | 1U;
+                        } else if(is_shift(action)) {
+                            errors.push_back(error_message("shift/reduce", state, symbol, rule_name(rule)));
+                        } else {
+                            errors.push_back(error_message("reduce/reduce", state, symbol,
+                                             rule_name(reduced_rule(action)) + " - prod: " + rule_name(rule)));
+                        }
+                    });
+                }
+            }
+        }
+
+        string error_message(const string& kind, uint32_t state, symbol_id symbol, const string& prods) const {
+            return "lalr table: " + kind + " conflict - state: " + to_string(state) + " - symbol: " + symbols.get_name(symbol) + " - prod: " + prods;
+        }
+
+        public:
+
+        // action cells: ERROR_ENTRY, (state << 1) to shift, (rule << 1) | 1 to reduce
+        static bool is_shift(uint32_t action) {return (action & 1U) == 0;}
+        static uint32_t shifted_state(uint32_t action) {return action >> 1U;}
+        static uint32_t reduced_rule(uint32_t action) {return action >> 1U;}
+
+        lalr_table() = default;
+        lalr_table(symbol_table symbols) : symbols(std::move(symbols)) {}
+
+        void build_tables(symbol_id start_symbol) {
+            errors.clear();
+            add_rules(start_symbol);
+            build_states();
+            build_lookaheads();
+            build_reductions();
+            // only the tables are needed to parse
+            kernels.clear();
+            lookaheads.clear();
+            rest_firsts.clear();
+            rest_nullable.clear();
+        }
+
+        uint32_t get_action(uint32_t state, symbol_id terminal) const {
+            return actions[state * symbols.get_terminal_count() + terminal];
+        }
+
+        uint32_t get_goto(uint32_t state, symbol_id non_terminal) const {
+            return gotos[state * symbols.get_non_terminal_count() + symbols.non_terminal_no(non_terminal)];
+        }
+
+        void set_nullables(nullables_table nullables) {this->nullables = std::move(nullables);}
+        void set_firsts(symbols_table firsts) {this->firsts = std::move(firsts);}
+        void set_productions(vprod productions) {this->productions = std::move(productions);}
+
+        const lr_rule& get_rule(uint32_t rule) const {return rules[rule];}
+        size_t get_rule_count() const {return rules.size();}
+        size_t get_state_count() const {return actions.size() / symbols.get_terminal_count();}
+        const vprod& get_productions() const {return productions;}
+        const symbol_table& get_symbols() const {return symbols;}
+        const vs& get_errors() const {return errors;}
+    };
+
+    // Builds the LALR(1) tables of grammar text in the grammar.dat format;
+    // errors as build_parsing_table(), with one message per conflict.
+    bool build_lalr_table(string_view grammar_text, lalr_table& lalr_table_, vs& errors) {
+        errors.clear();
+        grammar_parser grammar_parser;
+        if(!grammar_parser.parse(grammar_text)) {
+            errors.push_back(grammar_parser.get_error());
+            return false;
+        }
+
+        auto productions = grammar_parser.get_grammar();
+        const auto& symbols = grammar_parser.get_symbols();
+        symbol_id start_symbol = symbols.get_id(grammar_parser.get_start_symbol());
+
+        auto nullables = calc_nullables(productions, symbols);
+        auto firsts = calc_firsts(productions, symbols, nullables);
+
+        lalr_table_ = lalr_table(symbols);
+        lalr_table_.set_nullables(nullables);
+        lalr_table_.set_firsts(firsts);
+        lalr_table_.set_productions(productions);
+        lalr_table_.build_tables(start_symbol);
+
+        errors = lalr_table_.get_errors();
+        return errors.empty();
+    }
+}
@@ -1,260 +1,115 @@
 #pragma once
 
-#include "grammar.h"
+#include "lexer_dfa.h"
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <string_view>
+#include <cstdint>
+#include <algorithm>
 
 using namespace std;
 
 namespace xd
 {
-    struct token {
-        string token_type;
-        string value;
+    // token that refers to its lexeme inside a source buffer owned by the caller
+    struct token_span {
+        symbol_id token_type{NO_SYMBOL};
+        uint32_t length{};
+        size_t offset{};
 
-        token() = default;
+        token_span() = default;
 
-        token(string token_type, string value) : token_type(std::move(token_type)), value(std::move(value)) {};
-    };
-
-    class lexer {
+        token_span(symbol_id token_type, size_t offset, size_t length) :
+            token_type(token_type), length(static_cast<uint32_t>(length)), offset(offset) {};
 
-        // https://stackoverflow.com/questions/447206/c-isfloat-function
-        bool isFloat( string myString ) {
-            std::istringstream iss(myString);
-            float f;
-            iss >> noskipws >> f; // noskipws considers leading whitespace invalid
-            // Check the entire string was consumed and if either failbit or badbit is set
-            return iss.eof() && !iss.fail(); 
+        string_view value(string_view source) const {
+            return source.substr(offset, length);
         }
+    };
 
+    // A lexer keeps all of its state in the instance: the SIMD kernels of
+    // simd_scan.h picked for this CPU (or the ones passed in), which skip
+    // long runs, and the last error. Separate instances can run on different
+    // threads at the same time, one instance must not be shared between
+    // threads.
+    class lexer {
         string error;
+        run_scanner scanner;
+
+        size_t skip_run(lexer_dfa::run_state state, string_view source, size_t pos) const {
+            switch (state)
+            {
+            case lexer_dfa::SPACE:
+                return scanner.skip_space(source, pos);
+            case lexer_dfa::WORD:
+                return scanner.skip_word(source, pos);
+            case lexer_dfa::STRING:
+                return scanner.skip_string_body(source, pos);
+            case lexer_dfa::COMMENT_BODY:
+                return scanner.skip_comment_body(source, pos);
+            default:
+                return pos;
+            }
+        }
 
         public:
 
-        const string& get_error() {
-            return error;
-        }
+        lexer() = default;
 
-        token get_token(ifstream& ifs,const vector<string>& terminals) {
-            static char last_char = ' ';
-            while (!ifs.eof() && isspace(last_char)) {
-                ifs.get(last_char);
-            }
+        explicit lexer(scan_isa isa) : scanner(isa) {}
 
-            if(ifs.eof()) {
-                return token("__EOF__", "__EOF__");
-            }
+        scan_isa get_scan_isa() const {
+            return scanner.get_isa();
+        }
 
-            if(isalpha(last_char)) {
-                string identifier_string;
-                identifier_string += last_char;
-                while(ifs.get(last_char) && isalnum(last_char)) {
-                    identifier_string += last_char;
-                }
+        const string& get_error() {
+            return error;
+        }
 
-                if (ifs.eof()) {
-                    last_char = ' ';
-                }
+        void reset() {
+            error.clear();
+        }
 
-                if(find(terminals.begin(), terminals.end(), identifier_string) != terminals.end()) {
-                    return token(identifier_string, identifier_string);
-                } else if(identifier_string == "true" || identifier_string == "false") {
-                    return token("boolean_constant", identifier_string);
-                } else {
-                    return token("identifier", identifier_string);
+        // Scans source from pos with the DFA built from the grammar, leaves
+        // pos after the token and returns the token as a span of source.
+        token_span get_token(string_view source, size_t& pos, const lexer_dfa& dfa) {
+            for(;;) {
+                if(pos == source.size()) {
+                    return token_span(dfa.get_eof(), pos, 0);
                 }
-            }
-
-            if(isdigit(last_char) || last_char == '.') {
-                string num_string;
-
-                bool has_dot = false;
-                bool has_e = false;
-                bool has_sign = false;
-                bool has_digits_before_dot = false;
-                bool has_digits_after_dot = false;
-                bool has_digits_after_e = false;
 
-                bool is_error = false;
-
-                do {
-                    if (last_char == '.') {
-                        if (has_dot || has_e) {
-                            is_error = true;
-                            break;
-                        }
-                        has_dot = true;
-                    } else if (last_char == 'e' || last_char == 'E') {
-                        if (has_e) {
-                            is_error = true;
-                            break;
-                        }
-                        has_e = true;
-                    } else if (isdigit(last_char)) {
-                        if (has_e) {
-                            has_digits_after_e = true;
-                        } else if (has_dot) {
-                            has_digits_after_dot = true;
-                        } else {
-                            has_digits_before_dot = true;
-                        }
-                    } else if(isalpha(last_char)) {
-                        is_error = true;
-                        break;
-                    } else {
-                        break;
-                    }
-                    num_string += last_char;
-                }while(!ifs.eof() && ifs.get(last_char));
-
-                if(isalpha(last_char)) {
-                    num_string += last_char;
-                    while(ifs.get(last_char) && isalnum(last_char)) {
-                        num_string += last_char;
+                const size_t begin = pos;
+                lexer_dfa::match match = dfa.has_standard_runs()
+                    ? dfa.longest_match(source, begin, [this](lexer_dfa::run_state state, string_view text, size_t at) {
+                          return skip_run(state, text, at);
+                      })
+                    : dfa.longest_match(source, begin);
+                pos = match.end;
+
+                switch (match.kind)
+                {
+                case lexer_dfa::SKIP:
+                    continue;
+                case lexer_dfa::TOKEN:
+                    if(match.symbol != NO_SYMBOL) {
+                        return token_span(match.symbol, begin, pos - begin);
                     }
+                    break;
+                case lexer_dfa::COMMENT:
+                    return token_span(dfa.get_comment(), begin, pos - begin);
+                case lexer_dfa::NUMBER_ERROR:
+                    error = "Wrong fractional number format : " + string(source.substr(begin, pos - begin));
+                    return token_span(dfa.get_error(), begin, pos - begin);
+                case lexer_dfa::LITERAL_ERROR:
+                    error = "Wrong literal format";
+                    return token_span(dfa.get_error(), begin, pos - begin);
+                default:
+                    break;
                 }
 
-                if (ifs.eof()) {
-                    last_char = ' ';
-                }
-
-                if(is_error) {
-                    error = "Wrong fractional number format : " + num_string;
-                    return token("__ERROR__", "__ERROR__");
-                }
-
-                for(char& c : num_string) {
-                        if(!isdigit(c)) {
-                            return token("float_constant", num_string);
-                        }
-                    }
-                return token("integer_constant", num_string);
-            }
-
-            if(ispunct(last_char)) {
-                token tok;
-                static const vector<char> unary_punct({'(', ')', '[', ']', '{', '}', '*', '+', '-', '%', ',', ';'});
-                if(find(unary_punct.begin(), unary_punct.end(), last_char) != unary_punct.end()) {
-
-                    tok = token(string(1,last_char), string(1,last_char));
-                    ifs.get(last_char);
-                    if (ifs.eof()) {
-                        last_char = ' ';
-                    }
-                } else {
-                    string literal_string = "";
-                    switch (last_char)
-                    {
-                    case '&':
-                        ifs.get(last_char);
-                        if(last_char == '&') {
-                            ifs.get(last_char);
-                            tok = token("&&", "&&");
-                            break;
-                        }
-                        error = "Unexpected Token";
-                        tok = token("__ERROR__", "__ERROR__");
-                        break;
-                    case '|':
-                        ifs.get(last_char);
-                        if(last_char == '|') {
-                            ifs.get(last_char);
-                            tok = token("||", "||");
-                            break;
-                        }
-                        error = "Unexpected Token";
-                        tok = token("__ERROR__", "__ERROR__");
-                        break;
-                    case '=':
-                        ifs.get(last_char);
-                        if(last_char == '=') {
-                            ifs.get(last_char);
-                            tok = token("==", "==");
-                            break;
-                        }
-                        tok =  token("=", "=");
-                        break;
-
-                    case '!':
-                        ifs.get(last_char);
-                        if(last_char == '=') {
-                            ifs.get(last_char);
-                            tok =  token("!=", "!=");
-                            break;
-                        }
-                        tok =  token("!", "!");
-                        break;
-
-                    case '>':
-                        ifs.get(last_char);
-                        if(last_char == '=') {
-                            ifs.get(last_char);
-                            tok =  token(">=", ">=");
-                            break;
-                        }
-                        tok =  token(">", ">");
-                        break;
-                    
-                    case '<':
-                        ifs.get(last_char);
-                        if(last_char == '=') {
-                            ifs.get(last_char);
-                            tok =  token("<=", "<=");
-                            break;
-                        }
-                        tok =  token("<", "<");
-                        break;
-
-                    case '"':
-                        do {
-                            ifs.get(last_char);
-                            literal_string += last_char;
-                        }while(!ifs.eof() && last_char != '"');
-                        if(ifs.eof()) {
-                            error = "Wrong literal format";
-                            tok = token("__ERROR__", "__ERROR__");
-                            break;
-                        }
-
-                        literal_string.pop_back();
-                        ifs.get(last_char);
-                        tok = token("string_constant", '"' + literal_string + '"');
-                        break;
-
-                    case '/':
-                        ifs.get(last_char);
-                        if (last_char == '/') {
-                            do {
-                                ifs.get(last_char);
-                            }while(!ifs.eof() && last_char != '\n' && last_char != '\r');
-                            ifs.get(last_char);
-                            tok = token("__COMMENT__", "__COMMENT__");
-                            break;
-                        } else {
-                            tok = token("/", "/");
-                            break;
-                        }
-                        break;
-                    
-                    default:
-                        error = "Unexpected Token";
-                        tok = token("__ERROR__", "__ERROR__");
-                        break;
-                    }
-                    if (ifs.eof()) {
-                        last_char = ' ';
-                    }
-
-                    
-                }
-                
-                return tok;
+                error = "Unexpected Token";
+                return token_span(dfa.get_error(), begin, pos - begin);
             }
-            error = "Unexpected Token";
-            return token("__ERROR__", "__ERROR__");
-        } 
+        }
     };
 } // namespace xd
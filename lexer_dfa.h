@@ -0,0 +1,384 @@
+#pragma once
+
+#include "utils.h"
+#include "simd_scan.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+namespace xd {
+    // Terminal names of the lexeme classes that are not spelled out in the
+    // TERMINAL block. Every other terminal is either a keyword (identifier
+    // shaped) or a punctuator (punctuation only).
+    struct lexer_spec {
+        string identifier = "identifier";
+        string integer_constant = "integer_constant";
+        string float_constant = "float_constant";
+        string string_constant = "string_constant";
+        string boolean_constant = "boolean_constant";
+        vs boolean_literals = {"true", "false"};
+    };
+
+    // Table-driven DFA built from the terminals of a grammar. Bytes are mapped
+    // to equivalence classes, transitions are a dense [state][class] array,
+    // and identifier-shaped lexemes are resolved with a perfect hash.
+    // Immutable once built, so one instance can be shared by many lexers.
+    class lexer_dfa {
+        public:
+        enum match_kind : uint8_t {
+            REJECT,         // no token starts here
+            SKIP,           // whitespace
+            TOKEN,          // symbol is set, NO_SYMBOL when the class is not a terminal
+            COMMENT,
+            NUMBER_ERROR,   // malformed number
+            LITERAL_ERROR   // unterminated string
+        };
+
+        struct match {
+            match_kind kind;
+            symbol_id symbol;
+            size_t end;
+        };
+
+        // states whose only transition out of a run of bytes is a self loop,
+        // scanners may skip such runs wholesale
+        enum run_state : uint16_t {START, SPACE, WORD, STRING, COMMENT_BODY, RUN_STATES};
+
+        private:
+        static constexpr uint16_t DEAD = 0xFFFF;
+        // stop and report the lexeme so far as a malformed number
+        static constexpr uint16_t FAIL = 0xFFFE;
+
+        enum accept_kind : uint8_t {NONE, ACCEPT_SKIP, ACCEPT_SYMBOL, ACCEPT_WORD, ACCEPT_INTEGER,
+                                    ACCEPT_FLOAT, ACCEPT_STRING, ACCEPT_COMMENT, ACCEPT_NUMBER_ERROR, ACCEPT_LITERAL_ERROR};
+
+        struct state_info {
+            accept_kind accept{NONE};
+            symbol_id symbol{NO_SYMBOL};
+        };
+
+        array<uint8_t, 256> byte_class{};
+        size_t class_count{};
+        // the run states loop on exactly the byte sets of simd_scan.h
+        bool standard_runs{};
+        vector<uint16_t> next;
+        vector<state_info> states;
+
+        vs keywords;
+        vsym keyword_ids;
+        uint64_t keyword_seed{};
+        size_t keyword_mask{};
+
+        symbol_id integer_id{NO_SYMBOL};
+        symbol_id float_id{NO_SYMBOL};
+        symbol_id string_id{NO_SYMBOL};
+        symbol_id identifier_id{NO_SYMBOL};
+        symbol_id eof_id{NO_SYMBOL};
+        symbol_id error_id{NO_SYMBOL};
+        symbol_id comment_id{NO_SYMBOL};
+
+        static bool is_word(const string& name) {
+            if(name.empty() || !isalpha(static_cast<unsigned char>(name[0]))) {
+                return false;
+            }
+            return all_of(name.begin(), name.end(), [](char c) {return isalnum(static_cast<unsigned char>(c));});
+        }
+
+        static bool is_punctuator(const string& name) {
+            return !name.empty() && all_of(name.begin(), name.end(), [](char c) {return ispunct(static_cast<unsigned char>(c));});
+        }
+
+        static symbol_id terminal_id(const symbol_table& symbols, const string& name) {
+            symbol_id id = symbols.get_id(name);
+            return symbols.is_terminal(id) ? id : NO_SYMBOL;
+        }
+
+        size_t keyword_slot(string_view word, uint64_t seed, size_t mask) const {
+            return static_cast<size_t>(hash_bytes(word.data(), word.size(), seed)) & mask;
+        }
+
+        // finds a seed for which every keyword lands in its own slot
+        void build_keywords(const map<string, symbol_id>& words) {
+            size_t size = 1;
+            while(size < words.size() * 2) {
+                size <<= 1U;
+            }
+
+            for(;; size <<= 1U) {
+                for(uint64_t seed = 14695981039346656037ULL, tries = 0; tries < 4096; tries++, seed += 0x9E3779B97F4A7C15ULL) {
+                    vector<bool> used(size, false);
+                    bool perfect = true;
+                    for(const auto& word : words) {
+                        size_t slot = keyword_slot(word.first, seed, size - 1);
+                        if(used[slot]) {
+                            perfect = false;
+                            break;
+                        }
+                        used[slot] = true;
+                    }
+
+                    if(perfect) {
+                        keyword_seed = seed;
+                        keyword_mask = size - 1;
+                        keywords.assign(size, string());
+                        keyword_ids.assign(size, NO_SYMBOL);
+                        for(const auto& word : words) {
+                            size_t slot = keyword_slot(word.first, seed, keyword_mask);
+                            keywords[slot] = word.first;
+                            keyword_ids[slot] = word.second;
+                        }
+                        return;
+                    }
+                }
+            }
+        }
+
+        uint16_t add_state(accept_kind accept, symbol_id symbol = NO_SYMBOL) {
+            states.push_back({accept, symbol});
+            return static_cast<uint16_t>(states.size() - 1);
+        }
+
+        public:
+        lexer_dfa() = default;
+        explicit lexer_dfa(const symbol_table& symbols, const lexer_spec& spec = lexer_spec()) {
+            integer_id = terminal_id(symbols, spec.integer_constant);
+            float_id = terminal_id(symbols, spec.float_constant);
+            string_id = terminal_id(symbols, spec.string_constant);
+            identifier_id = terminal_id(symbols, spec.identifier);
+            eof_id = symbols.get_eof();
+            error_id = symbols.get_error();
+            comment_id = symbols.get_comment();
+
+            // keywords: identifier-shaped terminals, then the boolean literals
+            map<string, symbol_id> words;
+            vs punctuators;
+            for(symbol_id id = 0; id + 1 < symbols.get_terminal_count(); id++) {
+                const string& name = symbols.get_name(id);
+                if(is_word(name)) {
+                    words.emplace(name, id);
+                } else if(is_punctuator(name)) {
+                    punctuators.push_back(name);
+                }
+            }
+            for(const auto& literal : spec.boolean_literals) {
+                words.emplace(literal, terminal_id(symbols, spec.boolean_constant));
+            }
+            build_keywords(words);
+
+            // transitions over raw bytes first, compressed into classes below
+            vector<array<uint16_t, 256>> raw;
+            auto new_state = [&](accept_kind accept, symbol_id symbol = NO_SYMBOL) {
+                raw.emplace_back();
+                raw.back().fill(DEAD);
+                return add_state(accept, symbol);
+            };
+            auto each_byte = [](auto predicate, auto action) {
+                for(int c = 0; c < 256; c++) {
+                    if(predicate(static_cast<unsigned char>(c))) {
+                        action(c);
+                    }
+                }
+            };
+
+            uint16_t start = new_state(NONE);
+            uint16_t space = new_state(ACCEPT_SKIP);
+            uint16_t word = new_state(ACCEPT_WORD);
+            uint16_t string_body = new_state(ACCEPT_LITERAL_ERROR);
+            uint16_t comment_body = new_state(ACCEPT_COMMENT);
+            uint16_t string_end = new_state(ACCEPT_STRING);
+            uint16_t comment_end = new_state(ACCEPT_COMMENT);
+            uint16_t number = new_state(ACCEPT_INTEGER);
+            uint16_t number_dot = new_state(ACCEPT_FLOAT);
+            uint16_t number_exp = new_state(ACCEPT_FLOAT);
+            uint16_t number_bad = new_state(ACCEPT_NUMBER_ERROR);
+
+            auto is_space = [](unsigned char c) {return isspace(c) != 0;};
+            auto is_alpha = [](unsigned char c) {return isalpha(c) != 0;};
+            auto is_alnum = [](unsigned char c) {return isalnum(c) != 0;};
+            auto is_digit = [](unsigned char c) {return isdigit(c) != 0;};
+
+            each_byte(is_space, [&](int c) {raw[start][c] = space; raw[space][c] = space;});
+            each_byte(is_alpha, [&](int c) {raw[start][c] = word;});
+            each_byte(is_alnum, [&](int c) {raw[word][c] = word;});
+
+            each_byte([](unsigned char c) {return c != '"';}, [&](int c) {raw[string_body][c] = string_body;});
+            raw[start]['"'] = string_body;
+            raw[string_body]['"'] = string_end;
+
+            each_byte([](unsigned char c) {return c != '\n' && c != '\r';}, [&](int c) {raw[comment_body][c] = comment_body;});
+            raw[comment_body]['\n'] = comment_end;
+            raw[comment_body]['\r'] = comment_end;
+
+            // digits and '.' start a number; a second '.' or 'e' fails the
+            // number, other letters turn it into one malformed lexeme
+            each_byte(is_digit, [&](int c) {
+                raw[start][c] = number;
+                raw[number][c] = number;
+                raw[number_dot][c] = number_dot;
+                raw[number_exp][c] = number_exp;
+            });
+            for(uint16_t state : {number, number_dot, number_exp}) {
+                each_byte(is_alpha, [&](int c) {raw[state][c] = number_bad;});
+            }
+            each_byte(is_alnum, [&](int c) {raw[number_bad][c] = number_bad;});
+            raw[start]['.'] = number_dot;
+            raw[number]['.'] = number_dot;
+            raw[number_dot]['.'] = FAIL;
+            raw[number_exp]['.'] = FAIL;
+            for(int c : {'e', 'E'}) {
+                raw[number][c] = number_exp;
+                raw[number_dot][c] = number_exp;
+                raw[number_exp][c] = number_bad;
+            }
+
+            // punctuators form a trie below the start state
+            const uint16_t first_punctuator_state = static_cast<uint16_t>(states.size());
+            for(const auto& punctuator : punctuators) {
+                uint16_t state = start;
+                for(unsigned char c : punctuator) {
+                    uint16_t target = raw[state][c];
+                    if(target == DEAD) {
+                        target = new_state(NONE);
+                        raw[state][c] = target;
+                    } else if(target < first_punctuator_state) {
+                        // clashes with a lexeme class ('.' or '"'), the class wins
+                        state = DEAD;
+                        break;
+                    }
+                    state = target;
+                }
+                if(state != DEAD) {
+                    states[state] = {ACCEPT_SYMBOL, symbols.get_id(punctuator)};
+                }
+            }
+
+            uint16_t slash = raw[start]['/'];
+            if(slash == DEAD) {
+                slash = new_state(NONE);
+                raw[start]['/'] = slash;
+            }
+            if(raw[slash]['/'] == DEAD) {
+                raw[slash]['/'] = comment_body;
+            }
+
+            // a locale other than "C" may widen isspace/isalnum past the
+            // byte sets the run scanners assume
+            standard_runs = true;
+            for(int c = 0; c < 256; c++) {
+                uint8_t b = static_cast<uint8_t>(c);
+                standard_runs = standard_runs
+                    && (raw[space][c] == space) == is_space_byte(b)
+                    && (raw[word][c] == word) == is_word_byte(b)
+                    && (raw[string_body][c] == string_body) == is_string_byte(b)
+                    && (raw[comment_body][c] == comment_body) == is_comment_byte(b);
+            }
+
+            // bytes that behave alike in every state share a class
+            map<vector<uint16_t>, uint8_t> columns;
+            for(int c = 0; c < 256; c++) {
+                vector<uint16_t> column;
+                for(const auto& row : raw) {
+                    column.push_back(row[c]);
+                }
+                auto it = columns.emplace(column, static_cast<uint8_t>(columns.size())).first;
+                byte_class[c] = it->second;
+            }
+
+            class_count = columns.size();
+            next.assign(states.size() * class_count, DEAD);
+            for(size_t state = 0; state < raw.size(); state++) {
+                for(int c = 0; c < 256; c++) {
+                    next[state * class_count + byte_class[c]] = raw[state][c];
+                }
+            }
+        }
+
+        // Longest match starting at begin. Runs of bytes that keep the DFA in
+        // the same state are handed to skip_run, which returns the end of the run.
+        template<typename skip_run_t>
+        match longest_match(string_view source, size_t begin, skip_run_t skip_run) const {
+            const size_t size = source.size();
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(source.data());
+
+            uint16_t state = START;
+            size_t pos = begin;
+            uint16_t last_state = DEAD;
+            size_t last_end = begin;
+
+            while(pos < size) {
+                uint16_t target = next[state * class_count + byte_class[bytes[pos]]];
+                if(target == FAIL) {
+                    return {NUMBER_ERROR, NO_SYMBOL, pos};
+                }
+                if(target == DEAD) {
+                    break;
+                }
+                state = target;
+                pos++;
+                if(state < RUN_STATES) {
+                    pos = skip_run(static_cast<run_state>(state), source, pos);
+                }
+                if(states[state].accept != NONE) {
+                    last_state = state;
+                    last_end = pos;
+                }
+            }
+
+            if(last_state == DEAD) {
+                return {REJECT, NO_SYMBOL, pos == begin ? begin + 1 : pos};
+            }
+
+            const state_info& info = states[last_state];
+            switch (info.accept)
+            {
+            case ACCEPT_SKIP:
+                return {SKIP, NO_SYMBOL, last_end};
+            case ACCEPT_SYMBOL:
+                return {TOKEN, info.symbol, last_end};
+            case ACCEPT_WORD:
+                return {TOKEN, classify_word(source.substr(begin, last_end - begin)), last_end};
+            case ACCEPT_INTEGER:
+                return {TOKEN, integer_id, last_end};
+            case ACCEPT_FLOAT:
+                return {TOKEN, float_id, last_end};
+            case ACCEPT_STRING:
+                return {TOKEN, string_id, last_end};
+            case ACCEPT_COMMENT:
+                return {COMMENT, NO_SYMBOL, last_end};
+            case ACCEPT_NUMBER_ERROR:
+                return {NUMBER_ERROR, NO_SYMBOL, last_end};
+            case ACCEPT_LITERAL_ERROR:
+                return {LITERAL_ERROR, NO_SYMBOL, last_end};
+            default:
+                return {REJECT, NO_SYMBOL, last_end};
+            }
+        }
+
+        match longest_match(string_view source, size_t begin) const {
+            return longest_match(source, begin, [](run_state, string_view, size_t pos) {return pos;});
+        }
+
+        // keyword terminal, boolean literal or plain identifier
+        symbol_id classify_word(string_view word) const {
+            size_t slot = keyword_slot(word, keyword_seed, keyword_mask);
+            if(keywords[slot] == word && !word.empty()) {
+                return keyword_ids[slot];
+            }
+            return identifier_id;
+        }
+
+        symbol_id get_eof() const {return eof_id;}
+        symbol_id get_error() const {return error_id;}
+        symbol_id get_comment() const {return comment_id;}
+        size_t get_class_count() const {return class_count;}
+        bool has_standard_runs() const {return standard_runs;}
+        size_t get_state_count() const {return states.size();}
+    };
+}
@@ -0,0 +1,49 @@
+#include <bits/stdc++.h>
+
+#include "source_parser.h"
+#include "grammar_cache.h"
+#include "parser_codegen.h"
+
+using namespace std;
+using namespace xd;
+
+// Build-time generator: writes the C++ parser of a grammar, see
+// generate_parser(). Rerun it whenever the grammar changes.
+int main(int argc, char const *argv[])
+{
+    if(argc < 3) {
+        cout << "usage: ll1_codegen [grammar_file] [output_file] [class_name]";
+        return -1;
+    }
+    string grammar_filename = argv[1];
+    string output_filename = argv[2];
+    string class_name = argc > 3 ? argv[3] : "vc_parser";
+
+    mapped_file grammar_source(grammar_filename);
+    if(!grammar_source.is_open()) {
+        cout << "grammar: file not found";
+        return -1;
+    }
+
+    parsing_table parsing_table_;
+    symbol_id start_symbol;
+    vs errors;
+    if(!build_parsing_table(grammar_source.view(), parsing_table_, start_symbol, errors)) {
+        for(const auto& e : errors) {
+            cout << e << '\n';
+        }
+        return -1;
+    }
+
+    ostringstream source;
+    generate_parser(parsing_table_, start_symbol, grammar_cache::hash_source(grammar_source.view()),
+                    filesystem::path(grammar_filename).filename().string(), class_name, source);
+
+    ofstream output(output_filename, ios::binary);
+    output << source.str();
+    if(!output) {
+        cout << "cannot write " << output_filename;
+        return -1;
+    }
+    return 0;
+}
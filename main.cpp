@@ -1,95 +1,240 @@
 #include <bits/stdc++.h>
 
 #include "parser.h"
+#include "grammar_cache.h"
+#include "parallel_parser.h"
+#include "token_pipe.h"
+#include "source_parser.h"
+#include "lalr_parser.h"
+#include "vc_parser.h"
 
 using namespace std;
 using namespace xd;
 
 #define NAME "sample"
 
-int main(int argc, char const *argv[])
-{
-    string input_filename = "sample.vc";
-    string output_filename = "sample.vcps";
-    string output_filename_non_reduce = "sample_full.vcps";
-    string output_filename_bracket = "sample_bracket.vcps";
-    string grammar_filename = "grammar.dat";
+// Loads the precompiled grammar when it was built from the same grammar source,
+// otherwise analyses the grammar and refreshes the precompiled file.
+bool load_parsing_table(const string& grammar_filename, const string& cache_filename, parsing_table& parsing_table_, symbol_id& start_symbol) {
+    mapped_file grammar_source(grammar_filename);
+    if(!grammar_source.is_open()) {
+        cout << "grammar: file not found";
+        return false;
+    }
+    uint64_t grammar_hash = grammar_cache::hash_source(grammar_source.view());
 
-    if(argc > 1) {
-        input_filename = string(argv[1]) + ".vc";
-        if(argc > 2) {
-            output_filename = string(argv[2]) + ".vcps";
-            output_filename_non_reduce = string(argv[2]) + "_full.vcps";
-            output_filename_bracket = string(argv[2]) + "_bracket.vcps";
-            if(argc > 3) {
-                grammar_filename = string(argv[3]) + ".dat";
+    grammar_cache cache;
+    if(cache.load(cache_filename, grammar_hash)) {
+        parsing_table_ = parsing_table(cache.get_symbols());
+        parsing_table_.set_productions(cache.get_productions());
+        parsing_table_.set_table(cache.get_table());
+        parsing_table_.set_precedence(cache.get_precedence());
+        parsing_table_.set_shape(cache.get_shape());
+        start_symbol = cache.get_start_symbol();
+        return true;
+    }
+
+    vs errors;
+    if(!build_parsing_table(grammar_source.view(), parsing_table_, start_symbol, errors)) {
+        // a grammar that cannot be read has one message, conflicts one per line
+        if(parsing_table_.get_errors().empty()) {
+            cout << errors[0];
+        } else {
+            for (auto &e : errors)
+            {
+                std::cout << e << '\n';
             }
         }
+        return false;
     }
-    ifstream ifs(input_filename);
-    if(!ifs.good()){
-        cout << "cannot read input file";
-        return -1;
+
+    // a cache that cannot be written only costs the next run its startup time
+    cache.save(cache_filename, grammar_hash, parsing_table_, start_symbol);
+    return true;
+}
+
+// Builds the LALR(1) tables of the grammar. They are not cached, building
+// them takes a millisecond or two for grammar.dat.
+bool load_lalr_table(const string& grammar_filename, lalr_table& lalr_table_) {
+    mapped_file grammar_source(grammar_filename);
+    if(!grammar_source.is_open()) {
+        cout << "grammar: file not found";
+        return false;
     }
-    ofstream ofs(output_filename);
-    ofstream ofs2(output_filename_non_reduce);
-    ofstream ofs3(output_filename_bracket);
 
-    xd::grammar_parser grammar_parser(grammar_filename);
-    if(!grammar_parser.parse()) {
-        cout << grammar_parser.get_error();
-        return -1;
+    vs errors;
+    if(!build_lalr_table(grammar_source.view(), lalr_table_, errors)) {
+        // a grammar that cannot be read has one message, conflicts one per line
+        if(lalr_table_.get_errors().empty()) {
+            cout << errors[0];
+        } else {
+            for(const auto& e : errors) {
+                cout << e << '\n';
+            }
+        }
+        return false;
     }
+    return true;
+}
 
-    auto productions = grammar_parser.get_grammar();
+// which outputs to write for every input
+struct output_formats {
+    bool full = true;
+    bool reduced = true;
+    bool bracket = true;
+    bool ast = false;
+};
 
-    auto nullables = calc_nullables(productions);
-    auto firsts = calc_firsts(productions, nullables);
-    auto follows = calc_follows(productions, nullables, firsts, grammar_parser.get_start_symbol());
+// output streams of one input, opened for the requested formats only
+struct output_files {
+    ofstream reduced;
+    ofstream full;
+    ofstream bracket;
+    ofstream ast;
 
-    auto terminals = grammar_parser.get_terminals();
-    auto non_terminals = get_all_non_terminals(productions);
+    output_files(const string& output_base, const output_formats& formats) {
+        if(formats.reduced) reduced.open(output_base + ".vcps");
+        if(formats.full) full.open(output_base + "_full.vcps");
+        if(formats.bracket) bracket.open(output_base + "_bracket.vcps");
+        if(formats.ast) ast.open(output_base + ".ast", ios::binary);
+    }
+};
 
-    parsing_table parsing_table(terminals, non_terminals);
-    parsing_table.set_firsts(firsts);
-    parsing_table.set_follows(follows);
-    parsing_table.set_productions(productions);
-    parsing_table.build_tables();
+// the grammar, built once and only read afterwards: the LL(1) table, with
+// --lalr the LALR(1) tables, with --generated none
+struct grammar_state {
+    shared_ptr<const parsing_table> table;
+    shared_ptr<const lalr_table> lalr;
+    lexer_dfa dfa;
+    symbol_id start_symbol{NO_SYMBOL};
+    // parse expressions with the grammar's PRECEDENCE block
+    bool precedence = false;
+    // build trees with the grammar's SHAPE block
+    bool shape = false;
+    // parse with vc_parser, generated from grammar.dat by ll1_codegen
+    bool generated = false;
+    // look the LL(1) table up in its row displacement form
+    bool compact = false;
 
-    auto err = parsing_table.get_errors();
+    const symbol_table& get_symbols() const {
+        if(generated) {
+            return vc_parser::get_symbols();
+        }
+        return lalr ? lalr->get_symbols() : table->get_symbols();
+    }
+};
+
+// Loads the grammar into grammar, the LALR(1) tables with lalr. Prints why
+// the grammar cannot be used and returns false otherwise.
+bool load_grammar(const string& grammar_filename, const string& cache_filename, bool lalr, grammar_state& grammar) {
+    // the generated parser carries its grammar; a readable grammar file
+    // only checks that vc_parser.h was generated from it
+    if(grammar.generated) {
+        mapped_file grammar_source(grammar_filename);
+        if(grammar_source.is_open() && grammar_cache::hash_source(grammar_source.view()) != vc_parser::GRAMMAR_HASH) {
+            cout << "grammar: vc_parser.h was not generated from " << grammar_filename << ", rerun ll1_codegen";
+            return false;
+        }
+        grammar.dfa = lexer_dfa(vc_parser::get_symbols());
+        return true;
+    }
+    if(lalr) {
+        auto table = make_shared<lalr_table>();
+        if(!load_lalr_table(grammar_filename, *table)) {
+            return false;
+        }
+        grammar.dfa = lexer_dfa(table->get_symbols());
+        grammar.lalr = std::move(table);
+        return true;
+    }
+
+    parsing_table parsing_table_;
+    if(!load_parsing_table(grammar_filename, cache_filename, parsing_table_, grammar.start_symbol)) {
+        return false;
+    }
+    parsing_table_.set_compressed(grammar.compact);
+    grammar.dfa = lexer_dfa(parsing_table_.get_symbols());
+    grammar.table = make_shared<const parsing_table>(std::move(parsing_table_));
+    return true;
+}
+
+// Prints the parse errors, or writes the requested outputs of the tree.
+template<typename parser_t>
+bool report(const parser_t& ll1_parser, const output_formats& formats, output_files& outputs,
+            const string& ast_filename, ostream& messages) {
+    auto err = ll1_parser.get_errors();
     if (!err.empty())
     {
         for (auto &e : err)
         {
-            std::cout << e << '\n';
+            messages << e << '\n';
         }
-        return -1;
+        return false;
     }
 
-    
+    if(!ll1_parser.emit(formats.full ? &outputs.full : nullptr, formats.reduced ? &outputs.reduced : nullptr,
+                        formats.bracket ? &outputs.bracket : nullptr, formats.ast ? &outputs.ast : nullptr)) {
+        messages << "cannot write " << ast_filename;
+        return false;
+    }
+    return true;
+}
 
-    lexer lexer;
-    token token_;
+// Lexes and parses one source and writes its outputs. Diagnostics go to
+// messages; returns false if the input has errors.
+// With split_pool, the functions of the source are parsed on its threads.
+bool parse_source(string_view source, const grammar_state& grammar, const output_formats& formats,
+                  output_files& outputs, const string& ast_filename, lexer& lexer, parser& ll1_parser,
+                  ostream& messages, thread_pool* split_pool = nullptr) {
+    const auto& symbols = grammar.get_symbols();
+
+    token_span token_;
+    size_t pos = 0;
 
-    vector<token> tokens;
+    vector<token_span> tokens;
 
-    while((token_ = lexer.get_token(ifs, grammar_parser.get_terminals())).token_type != "__EOF__") {
-        if(token_.token_type == "__COMMENT__") {
+    while((token_ = lexer.get_token(source, pos, grammar.dfa)).token_type != symbols.get_eof()) {
+        if(token_.token_type == symbols.get_comment()) {
             continue;
         }
-        if(token_.token_type == "__ERROR__") {
-            cout << lexer.get_error();
-            return -1;
+        if(token_.token_type == symbols.get_error()) {
+            messages << lexer.get_error();
+            return false;
         }
         tokens.push_back(token_);
-        // cout << token_.value << " ";
     }
 
+    if(grammar.lalr) {
+        lalr_parser lalr_parser_;
+        lalr_parser_.set_input(source, std::move(tokens));
+        lalr_parser_.set_lalr_table(grammar.lalr);
+        lalr_parser_.restart();
+        while(!lalr_parser_.is_complete()) {
+            lalr_parser_.parser_next_step();
+        }
+        return report(lalr_parser_, formats, outputs, ast_filename, messages);
+    }
 
-    parser ll1_parser;
-    ll1_parser.set_input_tokens(tokens);
-    ll1_parser.set_parsing_table(parsing_table);
-    ll1_parser.set_start_symbol(grammar_parser.get_start_symbol());
+    if(grammar.generated) {
+        vc_parser generated_parser;
+        generated_parser.set_input(source, std::move(tokens));
+        generated_parser.parse();
+        return report(generated_parser, formats, outputs, ast_filename, messages);
+    }
+
+    if(split_pool) {
+        parallel_parser split_parser(grammar.table, grammar.start_symbol);
+        split_parser.set_precedence(grammar.precedence);
+        split_parser.set_shape(grammar.shape);
+        split_parser.parse(source, tokens, *split_pool);
+        return report(split_parser, formats, outputs, ast_filename, messages);
+    }
+
+    ll1_parser.set_input(source, std::move(tokens));
+    ll1_parser.set_parsing_table(grammar.table);
+    ll1_parser.set_start_symbol(grammar.start_symbol);
+    ll1_parser.set_precedence(grammar.precedence);
+    ll1_parser.set_shape(grammar.shape);
 
     ll1_parser.restart();
 
@@ -97,22 +242,398 @@ int main(int argc, char const *argv[])
         ll1_parser.parser_next_step();
     }
 
-    err = ll1_parser.get_errors();
-    if (!err.empty())
-    {
-        for (auto &e : err)
-        {
-            std::cout << e << '\n';
+    return report(ll1_parser, formats, outputs, ast_filename, messages);
+}
+
+// Counts the symbols of a derivation from parse events, without a tree.
+struct symbol_stats : parse_events {
+    vector<size_t> counts;
+    size_t depth = 0;
+    size_t max_depth = 0;
+
+    explicit symbol_stats(const symbol_table& symbols) :
+        counts(symbols.get_terminal_count() + symbols.get_non_terminal_count()) {}
+
+    void enter(symbol_id symbol) override {
+        counts[symbol]++;
+        max_depth = max(max_depth, ++depth);
+    }
+
+    void terminal(symbol_id symbol, string_view) override {
+        counts[symbol]++;
+    }
+
+    void exit(symbol_id) override {
+        depth--;
+    }
+
+    void print(const symbol_table& symbols, ostream& os) const {
+        size_t tokens = 0;
+        size_t expansions = 0;
+        for(symbol_id id = 0; id < counts.size(); id++) {
+            (symbols.is_terminal(id) ? tokens : expansions) += counts[id];
+        }
+        os << "tokens: " << tokens << '\n';
+        os << "expansions: " << expansions << '\n';
+        os << "max depth: " << max_depth << '\n';
+        for(symbol_id id = 0; id < counts.size(); id++) {
+            if(counts[id] != 0) {
+                os << symbols.get_name(id) << ' ' << counts[id] << '\n';
+            }
+        }
+    }
+};
+
+// parse_source() with lexing and parsing overlapped: the lexer runs on its
+// own thread and feeds the parser through a token_pipe, so the token stream
+// is never held as a whole. A lexer error stops the input there and is the
+// only message, as in parse_source(). With events the parse builds no tree
+// and writes no outputs, its memory stays bounded by the parse stack.
+bool stream_source(string_view source, const grammar_state& grammar, const output_formats& formats,
+                   output_files& outputs, const string& ast_filename, lexer& lexer, parser& ll1_parser,
+                   ostream& messages, parse_events* events = nullptr) {
+    const auto& symbols = grammar.table->get_symbols();
+    token_pipe pipe;
+    bool lexer_failed = false;
+
+    thread producer([&] {
+        vector<token_span> block;
+        block.reserve(token_pipe::BLOCK_TOKENS);
+        size_t pos = 0;
+        token_span token_;
+        while((token_ = lexer.get_token(source, pos, grammar.dfa)).token_type != symbols.get_eof()) {
+            if(token_.token_type == symbols.get_comment()) {
+                continue;
+            }
+            if(token_.token_type == symbols.get_error()) {
+                lexer_failed = true;
+                break;
+            }
+            block.push_back(token_);
+            if(block.size() == token_pipe::BLOCK_TOKENS) {
+                pipe.push(block);
+            }
+        }
+        if(!block.empty()) {
+            pipe.push(block);
+        }
+        pipe.close();
+    });
+
+    ll1_parser.set_input_stream(source, [&pipe](vector<token_span>& window) {pipe.pull(window);});
+    ll1_parser.set_parsing_table(grammar.table);
+    ll1_parser.set_start_symbol(grammar.start_symbol);
+    ll1_parser.set_precedence(grammar.precedence);
+    ll1_parser.set_shape(grammar.shape);
+    ll1_parser.set_events(events);
+
+    ll1_parser.restart();
+
+    while(!ll1_parser.is_complete()) {
+        ll1_parser.parser_next_step();
+    }
+
+    // the parse can end before the input does, the rest may still hold a
+    // lexer error
+    vector<token_span> rest;
+    do {
+        pipe.pull(rest);
+    } while(!rest.empty());
+    producer.join();
+
+    if(lexer_failed) {
+        messages << lexer.get_error();
+        return false;
+    }
+    if(events) {
+        for(const auto& e : ll1_parser.get_errors()) {
+            messages << e << '\n';
+        }
+        return ll1_parser.get_errors().empty();
+    }
+    return report(ll1_parser, formats, outputs, ast_filename, messages);
+}
+
+// .vc files of a directory in name order, or the lines of a list file
+bool list_inputs(const string& batch, vector<string>& inputs) {
+    error_code ec;
+    if(filesystem::is_directory(batch, ec)) {
+        for(const auto& entry : filesystem::directory_iterator(batch, ec)) {
+            if(entry.is_regular_file() && entry.path().extension() == ".vc") {
+                inputs.push_back(entry.path().string());
+            }
+        }
+        sort(inputs.begin(), inputs.end());
+        return !ec;
+    }
+    ifstream list(batch);
+    if(!list.good()) {
+        return false;
+    }
+    string line;
+    while(getline(list, line)) {
+        if(!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if(!line.empty()) {
+            inputs.push_back(line);
+        }
+    }
+    return true;
+}
+
+// Parses every input on a work-stealing pool against one shared grammar and
+// reports the diagnostics of each input in input order. Outputs go next to
+// each input (name.vc -> name.vcps, ...).
+int run_batch(const vector<string>& inputs, const grammar_state& grammar, const output_formats& formats, size_t jobs) {
+    struct worker_state {
+        lexer lexer_;
+        parser parser_;
+    };
+
+    thread_pool pool(jobs);
+    vector<worker_state> workers(pool.get_worker_count());
+    vector<string> messages(inputs.size());
+    vector<char> failed(inputs.size(), 0);
+
+    pool.run(inputs.size(), [&](size_t worker_no, size_t input_no) {
+        const string& input_filename = inputs[input_no];
+        ostringstream out;
+        mapped_file input(input_filename);
+        if(!input.is_open()) {
+            out << "cannot read input file";
+        } else {
+            string output_base = input_filename;
+            if(output_base.size() > 3 && output_base.compare(output_base.size() - 3, 3, ".vc") == 0) {
+                output_base.resize(output_base.size() - 3);
+            }
+            output_files outputs(output_base, formats);
+            worker_state& worker = workers[worker_no];
+            worker.lexer_.reset();
+            parse_source(input.view(), grammar, formats, outputs, output_base + ".ast", worker.lexer_, worker.parser_, out);
+        }
+        messages[input_no] = out.str();
+        failed[input_no] = !messages[input_no].empty();
+    });
+
+    size_t failures = 0;
+    for(size_t input_no = 0; input_no < inputs.size(); input_no++) {
+        if(failed[input_no]) {
+            failures++;
+            cout << inputs[input_no] << ":\n" << messages[input_no];
+            if(messages[input_no].back() != '\n') {
+                cout << '\n';
+            }
+        }
+    }
+    cout << inputs.size() - failures << "/" << inputs.size() << " files parsed\n";
+    return failures == 0 ? 0 : -1;
+}
+
+// Compares the dense and the row displacement form of the LL(1) table: the
+// bytes the lookups read and the time of one lookup, over all cells in a
+// shuffled order.
+void print_table_layout(const parsing_table& table, ostream& os) {
+    const symbol_table& symbols = table.get_symbols();
+    vector<pair<symbol_id, symbol_id>> cells;
+    size_t entries = 0;
+    for(symbol_id non_terminal = 0; non_terminal < symbols.get_non_terminal_count(); non_terminal++) {
+        for(symbol_id terminal = 0; terminal < symbols.get_terminal_count(); terminal++) {
+            cells.emplace_back(symbols.get_terminal_count() + non_terminal, terminal);
+            if(table.get_cell(cells.back().first, terminal) != ERROR_ENTRY) {
+                entries++;
+            }
+        }
+    }
+    shuffle(cells.begin(), cells.end(), mt19937(1));
+
+    auto lookup_time = [&](const parsing_table& layout) {
+        const size_t rounds = max<size_t>(1, (1U << 24) / cells.size());
+        unsigned int sum = 0;
+        auto start = chrono::steady_clock::now();
+        for(size_t round = 0; round < rounds; round++) {
+            for(const auto& [non_terminal, terminal] : cells) {
+                sum += layout.get_cell(non_terminal, terminal);
+            }
+        }
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+        volatile unsigned int keep = sum;
+        (void)keep;
+        return elapsed.count() / double(rounds * cells.size());
+    };
+
+    parsing_table dense = table;
+    dense.set_compressed(false);
+    parsing_table packed = table;
+    packed.set_compressed(true);
+    os << fixed << setprecision(2);
+    os << "table: " << symbols.get_non_terminal_count() << " x " << symbols.get_terminal_count()
+       << " cells, " << entries << " entries\n";
+    os << "dense: " << dense.get_lookup_bytes() << " bytes, " << lookup_time(dense) << " ns/lookup\n";
+    os << "packed: " << packed.get_packed_size() << " slots, " << packed.get_lookup_bytes() << " bytes ("
+       << 100.0 * packed.get_lookup_bytes() / dense.get_lookup_bytes() << "% of dense), "
+       << lookup_time(packed) << " ns/lookup\n";
+}
+
+int main(int argc, char const *argv[])
+{
+    string input_filename = "sample.vc";
+    string output_base = "sample";
+    string grammar_filename = "grammar.dat";
+    string cache_filename = "grammar.ll1";
+
+    // --formats=full,reduced,bracket,ast picks the outputs to write, the
+    // three text outputs by default
+    output_formats formats;
+    // --batch=<directory or list file> parses many inputs, --jobs=N on N threads
+    string batch;
+    size_t jobs = 0;
+    // --split parses the functions of one input on --jobs threads
+    bool split = false;
+    // --stream lexes one input on a second thread while it is parsed
+    bool stream = false;
+    // --stats prints symbol counts from parse events instead of writing trees
+    bool stats = false;
+    // --precedence parses expressions with the grammar's PRECEDENCE block
+    bool precedence = false;
+    // --shape builds trees with the grammar's SHAPE block
+    bool shape = false;
+    // --lalr parses with LALR(1) tables and a shift-reduce parser
+    bool lalr = false;
+    // --generated parses with vc_parser instead of a table built from the grammar file
+    bool generated = false;
+    // --compact looks the LL(1) table up in its row displacement form
+    bool compact = false;
+    // --table-stats compares the dense and the compact table instead of parsing
+    bool table_stats = false;
+    vector<string> args;
+    for(int i = 1; i < argc; i++) {
+        string_view arg = argv[i];
+        if(arg.substr(0, 10) == "--formats=") {
+            string names = "," + string(arg.substr(10)) + ",";
+            formats.full = names.find(",full,") != string::npos;
+            formats.reduced = names.find(",reduced,") != string::npos;
+            formats.bracket = names.find(",bracket,") != string::npos;
+            formats.ast = names.find(",ast,") != string::npos;
+        } else if(arg.substr(0, 8) == "--batch=") {
+            batch = string(arg.substr(8));
+        } else if(arg == "--split") {
+            split = true;
+        } else if(arg == "--stream") {
+            stream = true;
+        } else if(arg == "--stats") {
+            stats = true;
+        } else if(arg == "--precedence") {
+            precedence = true;
+        } else if(arg == "--shape") {
+            shape = true;
+        } else if(arg == "--lalr") {
+            lalr = true;
+        } else if(arg == "--generated") {
+            generated = true;
+        } else if(arg == "--compact") {
+            compact = true;
+        } else if(arg == "--table-stats") {
+            table_stats = true;
+        } else if(arg.substr(0, 7) == "--jobs=") {
+            jobs = strtoul(string(arg.substr(7)).c_str(), nullptr, 10);
+        } else {
+            args.emplace_back(arg);
+        }
+    }
+
+    if(table_stats) {
+        // the only positional argument is the grammar
+        if(args.size() > 0) {
+            grammar_filename = args[0] + ".dat";
+            cache_filename = args[0] + ".ll1";
         }
+        grammar_state grammar;
+        if(!load_grammar(grammar_filename, cache_filename, false, grammar)) {
+            return -1;
+        }
+        print_table_layout(*grammar.table, cout);
+        return 0;
+    }
+
+    // symbol counts come from the events of the table-driven parser of one input
+    if(stats && (lalr || generated || !batch.empty())) {
+        cout << "--stats cannot be used with --lalr, --generated or --batch";
         return -1;
     }
 
-    ll1_parser.build_tree();
-    ll1_parser.print_node(ofs2);
-    ll1_parser.remove_epsilon_node();
-    ll1_parser.remove_one_kid_node();
-    ll1_parser.print_node(ofs);
-    ll1_parser.print_bracket(ofs3);
+    if(!batch.empty()) {
+        // the only positional argument is the grammar
+        if(args.size() > 0) {
+            grammar_filename = args[0] + ".dat";
+            cache_filename = args[0] + ".ll1";
+        }
+        vector<string> inputs;
+        if(!list_inputs(batch, inputs)) {
+            cout << "cannot read input list";
+            return -1;
+        }
+        grammar_state grammar;
+        grammar.precedence = precedence;
+        grammar.shape = shape;
+        grammar.generated = generated;
+        grammar.compact = compact;
+        if(!load_grammar(grammar_filename, cache_filename, lalr, grammar)) {
+            return -1;
+        }
+        return run_batch(inputs, grammar, formats, jobs);
+    }
+
+    if(args.size() > 0) {
+        input_filename = args[0] + ".vc";
+        if(args.size() > 1) {
+            output_base = args[1];
+            if(args.size() > 2) {
+                grammar_filename = args[2] + ".dat";
+                cache_filename = args[2] + ".ll1";
+            }
+        }
+    }
+    mapped_file input(input_filename);
+    if(!input.is_open()){
+        cout << "cannot read input file";
+        return -1;
+    }
+    output_files outputs(output_base, stats ? output_formats{false, false, false, false} : formats);
+
+    grammar_state grammar;
+    grammar.precedence = precedence;
+    grammar.shape = shape;
+    grammar.generated = generated;
+    grammar.compact = compact;
+    if(!load_grammar(grammar_filename, cache_filename, lalr, grammar)) {
+        return -1;
+    }
+
+    lexer lexer;
+    parser ll1_parser;
+    unique_ptr<thread_pool> split_pool;
+    if(split) {
+        split_pool = make_unique<thread_pool>(jobs);
+    }
+    if(stats) {
+        symbol_stats counter(grammar.table->get_symbols());
+        if(!stream_source(input.view(), grammar, formats, outputs, output_base + ".ast", lexer, ll1_parser, cout, &counter)) {
+            return -1;
+        }
+        counter.print(grammar.table->get_symbols(), cout);
+        return 0;
+    }
+    // the LALR(1) and generated parsers only parse whole token sequences into trees
+    if(stream && !split && !lalr && !generated) {
+        if(!stream_source(input.view(), grammar, formats, outputs, output_base + ".ast", lexer, ll1_parser, cout)) {
+            return -1;
+        }
+        return 0;
+    }
+    if(!parse_source(input.view(), grammar, formats, outputs, output_base + ".ast", lexer, ll1_parser, cout, split_pool.get())) {
+        return -1;
+    }
 
     return 0;
 }
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define XD_HAS_MMAP 1
+#endif
+
+using namespace std;
+
+namespace xd {
+    // Read-only view of a whole file, memory mapped where the platform allows
+    // and read into an owned buffer otherwise.
+    class mapped_file {
+        const char* data_{nullptr};
+        size_t size_{0};
+        bool mapped{false};
+        bool opened{false};
+        string buffer;
+
+        void close() {
+#ifdef XD_HAS_MMAP
+            if(mapped) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+#endif
+            data_ = nullptr;
+            size_ = 0;
+            mapped = false;
+            opened = false;
+            buffer.clear();
+        }
+
+        public:
+        mapped_file() = default;
+        explicit mapped_file(const string& filename) {
+            open(filename);
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        mapped_file& operator=(mapped_file&& other) noexcept {
+            if(this != &other) {
+                close();
+                mapped = other.mapped;
+                opened = other.opened;
+                size_ = other.size_;
+                buffer = std::move(other.buffer);
+                data_ = mapped ? other.data_ : buffer.data();
+                other.data_ = nullptr;
+                other.size_ = 0;
+                other.mapped = false;
+                other.opened = false;
+            }
+            return *this;
+        }
+
+        ~mapped_file() {
+            close();
+        }
+
+        bool open(const string& filename) {
+            close();
+#ifdef XD_HAS_MMAP
+            int fd = ::open(filename.c_str(), O_RDONLY);
+            if(fd < 0) {
+                return false;
+            }
+
+            struct stat st{};
+            if(fstat(fd, &st) != 0) {
+                ::close(fd);
+                return false;
+            }
+
+            size_ = static_cast<size_t>(st.st_size);
+            if(size_ > 0) {
+                void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(addr == MAP_FAILED) {
+                    ::close(fd);
+                    size_ = 0;
+                    return false;
+                }
+                data_ = static_cast<const char*>(addr);
+                mapped = true;
+            } else {
+                data_ = buffer.data();
+            }
+            ::close(fd);
+#else
+            ifstream ifs(filename, ios::binary);
+            if(!ifs.good()) {
+                return false;
+            }
+            stringstream ss;
+            ss << ifs.rdbuf();
+            buffer = ss.str();
+            data_ = buffer.data();
+            size_ = buffer.size();
+#endif
+            opened = true;
+            return true;
+        }
+
+        bool is_open() const {return opened;}
+        const char* data() const {return data_;}
+        size_t size() const {return size_;}
+        string_view view() const {return string_view(data_, size_);}
+    };
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "parser.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace xd {
+    // Parses a program that is a list of items, <S> : <X> <T>, <T> : <X> <T>
+    // and <T> : EPSILON (<program>, <func_decl>, <program_tail> in VC), one
+    // item per task. Items are found by a pre-scan for top-level brace
+    // balanced bodies; the item trees are stitched under the <S>/<T> spine.
+    // LL(1) grammars are unambiguous, so when every item parses on its own
+    // the stitched tree is the tree of the sequential parse. Otherwise, and
+    // for grammars of another shape, the whole input is parsed sequentially,
+    // which also keeps the error messages of the sequential parse.
+    class parallel_parser {
+        shared_ptr<const parsing_table> parsing_table_;
+        symbol_id start_symbol{NO_SYMBOL};
+        symbol_id item_symbol{NO_SYMBOL};
+        symbol_id tail_symbol{NO_SYMBOL};
+        symbol_id open_brace{NO_SYMBOL};
+        symbol_id close_brace{NO_SYMBOL};
+
+        string_view source;
+        parsing_tree ast;
+        parser sequential;
+        vector<parser> workers;
+        bool use_precedence{};
+        bool use_shape{};
+        vs errors;
+
+        const production* find_production(symbol_id parent) const {
+            for(const auto& prod : parsing_table_->get_productions()) {
+                if(prod.get_parent() == parent) {
+                    return &prod;
+                }
+            }
+            return nullptr;
+        }
+
+        // recognises <S> : <X> <T>, <T> : <X> <T> | EPSILON
+        void find_item_list() {
+            const symbol_table& symbols = parsing_table_->get_symbols();
+            const production* start = find_production(start_symbol);
+            if(!start || start->get_rules().size() != 1) return;
+            const vsym& head = start->get_rules()[0].get_entities();
+            if(head.size() != 2 || !symbols.is_non_terminal(head[0]) || !symbols.is_non_terminal(head[1])) return;
+
+            const production* tail = find_production(head[1]);
+            if(!tail || tail->get_rules().size() != 2) return;
+            bool has_item = false;
+            bool has_epsilon = false;
+            for(const auto& tail_rule : tail->get_rules()) {
+                has_item = has_item || tail_rule.get_entities() == head;
+                has_epsilon = has_epsilon || tail_rule.get_entities() == vsym{symbols.get_epsilon()};
+            }
+            if(!has_item || !has_epsilon) return;
+
+            item_symbol = head[0];
+            tail_symbol = head[1];
+            open_brace = symbols.get_id("{");
+            close_brace = symbols.get_id("}");
+        }
+
+        // [begin, end) token ranges, one per item; false if the stream does
+        // not split into brace balanced items
+        bool split_items(const vector<token_span>& tokens, vector<pair<size_t, size_t>>& items) const {
+            size_t begin = 0;
+            size_t depth = 0;
+            bool in_body = false;
+            for(size_t step = 0; step < tokens.size(); step++) {
+                symbol_id type = tokens[step].token_type;
+                if(type == open_brace) {
+                    depth++;
+                    in_body = true;
+                } else if(type == close_brace) {
+                    if(depth == 0) return false;
+                    depth--;
+                    if(depth == 0) {
+                        items.emplace_back(begin, step + 1);
+                        begin = step + 1;
+                        in_body = false;
+                    }
+                }
+            }
+            return begin == tokens.size() && !in_body && items.size() > 1;
+        }
+
+        void parse_sequential(const vector<token_span>& tokens) {
+            sequential.set_input(source, tokens);
+            sequential.set_parsing_table(parsing_table_);
+            sequential.set_start_symbol(start_symbol);
+            sequential.set_precedence(use_precedence);
+            sequential.set_shape(use_shape);
+            sequential.restart();
+            while(!sequential.is_complete()) {
+                sequential.parser_next_step();
+            }
+            errors = sequential.get_errors();
+            ast = sequential.release_tree();
+        }
+
+        public:
+
+        parallel_parser(shared_ptr<const parsing_table> table, symbol_id start_symbol) :
+            parsing_table_(std::move(table)), start_symbol(start_symbol) {
+            find_item_list();
+        }
+
+        // see parser::set_precedence()
+        void set_precedence(bool use) {
+            use_precedence = use;
+        }
+
+        // see parser::set_shape(); the shaped tree has no item list to graft
+        // the items into, so the input is parsed sequentially
+        void set_shape(bool use) {
+            use_shape = use;
+        }
+
+        bool can_split() const {return item_symbol != NO_SYMBOL && open_brace != NO_SYMBOL && close_brace != NO_SYMBOL;}
+
+        // parses tokens, spans into source, with the items spread over pool
+        void parse(string_view source, const vector<token_span>& tokens, thread_pool& pool) {
+            this->source = source;
+            ast.clear();
+            errors.clear();
+
+            vector<pair<size_t, size_t>> items;
+            if(use_shape || !can_split() || !split_items(tokens, items)) {
+                parse_sequential(tokens);
+                return;
+            }
+
+            workers.resize(pool.get_worker_count());
+            vector<parsing_tree> item_trees(items.size());
+            vector<char> failed(items.size(), 0);
+            pool.run(items.size(), [&](size_t worker_no, size_t item_no) {
+                parser& worker = workers[worker_no];
+                worker.set_input(source, vector<token_span>(tokens.begin() + items[item_no].first, tokens.begin() + items[item_no].second));
+                worker.set_parsing_table(parsing_table_);
+                worker.set_start_symbol(item_symbol);
+                worker.set_precedence(use_precedence);
+                worker.restart();
+                while(!worker.is_complete()) {
+                    worker.parser_next_step();
+                }
+                failed[item_no] = !worker.get_errors().empty() || !worker.consumed_input();
+                item_trees[item_no] = worker.release_tree();
+            });
+
+            for(char item_failed : failed) {
+                if(item_failed) {
+                    parse_sequential(tokens);
+                    return;
+                }
+            }
+
+            // every item derives a terminal, the last tail only EPSILON
+            const symbol_table& symbols = parsing_table_->get_symbols();
+            ast.set_root(start_symbol, symbols.get_name(start_symbol));
+            vector<node_id> item_roots;
+            for(const auto& item_tree : item_trees) {
+                item_roots.push_back(ast.append(item_tree));
+            }
+            node_id parent = ast.get_root();
+            for(node_id item_root : item_roots) {
+                ast[parent].is_epsilon = false;
+                ast.attach_kid(parent, item_root);
+                parent = ast.add_kid(parent, tail_symbol, symbols.get_name(tail_symbol), true);
+            }
+            ast.add_kid(parent, symbols.get_epsilon(), symbols.get_name(symbols.get_epsilon()), true);
+        }
+
+        // errors of the sequential parse; a split parse has none
+        const vs& get_errors() const {return errors;}
+
+        bool emit(ostream* full, ostream* reduced, ostream* bracket, ostream* binary = nullptr) const {
+            return ast.emit(parsing_table_->get_symbols(), source, full, reduced, bracket, binary);
+        }
+
+        const parsing_tree& get_tree() const {return ast;}
+    };
+}
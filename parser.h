@@ -2,298 +2,412 @@
 
 #include "parsing_table.h"
 #include "lexer.h"
+#include "parsing_tree.h"
+#include "shape_builder.h"
 #include <stack>
 #include <iostream>
 #include <memory>
+#include <functional>
 
 using namespace std;
 
 namespace xd {
 
-    struct parsing_node {
-        string token_type;
-        string value;
-        bool is_epsilon{true};
-        vector<shared_ptr<parsing_node>> kids;
-
-        // https://stackoverflow.com/questions/59508678/c-print-tree-not-necessarily-binary-in-a-pretty-way-to-stdout
-        void print_sub_tree(const string &prefix, ofstream& ofs) {
-            if(kids.empty()) return;
-            ofs << prefix;
-            size_t n_kids = kids.size();
-            ofs << (n_kids > 1 ? "├── " : "");
-
-            for (size_t i = 0; i < n_kids; ++i) {
-                shared_ptr<parsing_node> kid = kids[i];
-                if (i < n_kids - 1) {
-                    if (i > 0) { // added fix
-                    ofs << prefix << "├── "; // added fix
-                    }
-                    bool printStrand = n_kids > 1 && !kid->kids.empty();
-                    string newPrefix = prefix + (printStrand ? "│\t" : "\t");
-                    ofs << kid->value << "\n";
-                    kid->print_sub_tree(newPrefix, ofs);
-                } else {
-                    ofs << (n_kids > 1 ? prefix : "") << "└── ";
-                    ofs << kid->value << "\n";
-                    kid->print_sub_tree(prefix + "\t", ofs);
-                }
-            }
-        }
-
-        void print(ofstream& ofs) {
-            ofs << value << "\n";
-            print_sub_tree("", ofs);
-            ofs << "\n";
-        }
-    };
-
     class parser{
-        vector<token> input_tokens;
-        string start_symbol;
-        vector<token> current_tokens;
+        string_view source;
+        // all tokens, or in stream mode the window that holds current_step;
+        // window_base is the step of its first token
+        vector<token_span> input_tokens;
+        size_t window_base{};
+        bool input_done{true};
+        function<void(vector<token_span>&)> next_tokens;
+        symbol_id start_symbol{NO_SYMBOL};
         size_t current_step{};
-        parsing_table parsing_table_;
-        stack<string> stack_;
-        shared_ptr<parsing_node> ast;
+        size_t matched_tokens{};
+        // immutable once set, so parsers on several threads can share one table
+        shared_ptr<const parsing_table> parsing_table_;
+        // grammar symbol and the tree node it expands into or matches. In
+        // event mode there is no tree: node is NO_NODE for a symbol still to
+        // expand or match, else the number of exit() calls due for symbol,
+        // so a right-recursive list takes one entry however long it is.
+        struct stack_entry {
+            symbol_id symbol;
+            node_id node;
+        };
+
+        stack<stack_entry> stack_;
+        parsing_tree ast;
+        bool keep_history{};
         vector<size_t> history;
         vector<string> errors;
+        // events receives the derivation: the user's events, the shape
+        // builder or nullptr when the parser builds the tree itself
+        parse_events* events{};
+        parse_events* user_events{};
+        bool use_shape{};
+        shape_builder builder;
+
+        // Operator precedence mode: an expression (the entry symbol of the
+        // grammar's PRECEDENCE block) is read as operands, each parsed as the
+        // operand symbol with the table, and binary operators between them.
+        // A marker entry below every operand resumes the expression, which
+        // reduces its operators shunting-yard style into nodes [left, op,
+        // right] and hangs the result under the entry symbol's node.
+        static const symbol_id OPERATOR_STEP = NO_SYMBOL - 1;
+        struct pending_operator {
+            uint32_t level;
+            node_id node;
+        };
+        struct expression_frame {
+            node_id entry;
+            size_t operand_base;
+            size_t operator_base;
+        };
+        bool use_precedence{};
+        vector<expression_frame> expressions;
+        vector<node_id> operands;
+        vector<pending_operator> operators;
 
         void jump() {
             if(!is_complete()) {
                 current_step ++;
+                pull_tokens();
             }
         }
 
-        void DFS(shared_ptr<parsing_node> node) {
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                DFS(kid_node);
-                if(!kid_node->is_epsilon) {
-                    node->is_epsilon = false;
-                }
+        // stream mode: moves the window on once current_step leaves it
+        void pull_tokens() {
+            while(!input_done && current_step - window_base >= input_tokens.size()) {
+                window_base += input_tokens.size();
+                next_tokens(input_tokens);
+                input_done = input_tokens.empty();
             }
         }
 
-        void remove(shared_ptr<parsing_node> node) {
-            vector<shared_ptr<parsing_node>> new_kids;
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                remove(kid_node);
-                if(!kid_node->is_epsilon) {
-                    new_kids.push_back(kid_node);
+        // the token stream ends with an implicit end marker
+        symbol_id token_type_at(size_t step) const {
+            return step - window_base < input_tokens.size() ? input_tokens[step - window_base].token_type
+                                                            : parsing_table_->get_symbols().get_endmarker();
+        }
+
+        void fire_exits() {
+            while(stack_.top().node != NO_NODE) {
+                stack_entry done = stack_.top();
+                stack_.pop();
+                for(node_id no = 0; no < done.node; no++) {
+                    events->exit(done.symbol);
                 }
             }
-            node->kids = std::move(new_kids);
         }
 
-        void remove_kid(shared_ptr<parsing_node> node, shared_ptr<parsing_node> parent) {
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                remove_kid(kid_node, node);
+        // the entry is NO_SYMBOL without a PRECEDENCE block
+        bool hands_over(symbol_id symbol) const {
+            return use_precedence && !events && symbol == parsing_table_->get_precedence().get_entry();
+        }
+
+        // expands the entry symbol's node into an expression, first operand
+        void begin_expression(node_id entry) {
+            expressions.push_back({entry, operands.size(), operators.size()});
+            push_operand();
+        }
+
+        void push_operand() {
+            const symbol_table& symbols = parsing_table_->get_symbols();
+            symbol_id operand = parsing_table_->get_precedence().get_operand();
+            node_id node = ast.add_node(operand, symbols.get_name(operand), true);
+            operands.push_back(node);
+            stack_.push({OPERATOR_STEP, NO_NODE});
+            stack_.push({operand, node});
+        }
+
+        void reduce_operator() {
+            const symbol_table& symbols = parsing_table_->get_symbols();
+            pending_operator op = operators.back();
+            operators.pop_back();
+            node_id right = operands.back();
+            operands.pop_back();
+            node_id left = operands.back();
+            symbol_id symbol = parsing_table_->get_precedence().get_levels()[op.level].symbol;
+            node_id node = ast.add_node(symbol, symbols.get_name(symbol), false);
+            ast.attach_kid(node, left);
+            ast.attach_kid(node, op.node);
+            ast.attach_kid(node, right);
+            operands.back() = node;
+        }
+
+        // whether the symbol below a finished expression takes type
+        bool follows_expression(symbol_id type) const {
+            symbol_id next = stack_.top().symbol;
+            if(next == OPERATOR_STEP) {
+                return true;
             }
-            if(!parent) return;
-            if(node->kids.size() == 1) {
-                shared_ptr<parsing_node> kid_node = node->kids[0];
-                for(size_t id = 0;id < parent->kids.size();id++) {
-                    if(parent->kids[id] == node) {
-                        parent->kids[id] = kid_node;
-                        return;
-                    }
-                }
+            if(parsing_table_->get_symbols().is_non_terminal(next)) {
+                return parsing_table_->get_cell(next, type) != ERROR_ENTRY;
             }
+            return next == type;
         }
 
-        void set(shared_ptr<parsing_node> node, vector<token>& tokens, int& index) {
-            auto& terminals = parsing_table_.get_terminals();
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                if(find(terminals.begin(), terminals.end(), kid_node->token_type) != terminals.end()) {
-                    kid_node->value = tokens[index++].value;
-                } else {
-                    kid_node->value = kid_node->token_type;
+        // An operand is done: takes the binary operator that follows, or
+        // ends the expression. Like the error loop on the grammar's _temp
+        // levels, a token that can neither continue nor end the expression
+        // is reported and skipped.
+        void expression_step() {
+            const operator_precedence& precedence = parsing_table_->get_precedence();
+            stack_.pop();
+            const expression_frame frame = expressions.back();
+            symbol_id current_type = token_type_at(current_step);
+            uint32_t level = precedence.get_level(current_type);
+            if(level != operator_precedence::NO_LEVEL) {
+                const bool right_assoc = precedence.get_levels()[level].right_assoc;
+                while(operators.size() > frame.operator_base &&
+                      (operators.back().level > level || (operators.back().level == level && !right_assoc))) {
+                    reduce_operator();
                 }
-                set(kid_node, tokens, index);
+                string_view value = input_tokens[current_step - window_base].value(source);
+                operators.push_back({level, ast.add_node(current_type, value, false)});
+                push_operand();
+                matched_tokens++;
+                jump();
+                return;
             }
-        }
 
-        void print(shared_ptr<parsing_node> node) {
-            auto& terminals = parsing_table_.get_terminals();
-            if(node->kids.size()) {
-                cout << node->value << " : ";
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                cout << kid_node->value << " ";
-            }
-            cout << "\n";
+            if(!follows_expression(current_type)) {
+                errors.push_back(error_message(current_type));
+                stack_.push({OPERATOR_STEP, NO_NODE});
+                jump();
+                return;
             }
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                print(kid_node);
+
+            while(operators.size() > frame.operator_base) {
+                reduce_operator();
             }
+            ast.attach_kid(frame.entry, operands.back());
+            ast.mark_non_epsilon(frame.entry);
+            operands.pop_back();
+            expressions.pop_back();
         }
 
-        string error_message(const string& symbol) {
-            return "parser: error at symbol: " + symbol;
+        string error_message(symbol_id symbol) {
+            return "parser: error at symbol: " + parsing_table_->get_symbols().get_name(symbol);
         }
 
         public:
 
-        parser() {
-            stack_.push(std::string(STRING_ENDMARKER));
-            input_tokens.clear();
-            current_tokens.clear();
-        }
+        parser() = default;
 
+        // expansions packed as (prod_no << 16) ^ rule_no, recorded only
+        // after set_keep_history(true)
         const vector<size_t>& get_history() {
             return history;
         }
 
+        void set_keep_history(bool keep) {
+            keep_history = keep;
+        }
+
+        // Parses the expressions of a grammar with a PRECEDENCE block with
+        // the operator precedence parser: one node per binary operator
+        // instead of a chain of levels per operand. Tree mode only.
+        void set_precedence(bool use) {
+            use_precedence = use;
+        }
+
+        // Event mode: with events set, the parse reports to events instead of
+        // building a tree, and keeps no more than its stack. The events of an
+        // input with errors stop where the parse does. nullptr returns to
+        // building trees. Takes effect at restart().
+        void set_events(parse_events* events) {
+            user_events = events;
+        }
+
+        // Builds the tree with the SHAPE block of the grammar applied (see
+        // shape_builder) instead of the full derivation tree. Takes the
+        // place of precedence mode, and is off while events are set.
+        void set_shape(bool use) {
+            use_shape = use;
+        }
+
+        // every token was matched; a parse can also complete with tokens left
+        // over once the start symbol is done
+        bool consumed_input() const {
+            return input_done && matched_tokens == window_base + input_tokens.size();
+        }
+
         bool is_complete() {
-            return current_step == current_tokens.size() || stack_.top() == STRING_ENDMARKER;
+            return (input_done && current_step == window_base + input_tokens.size() + 1) ||
+                   stack_.top().symbol == parsing_table_->get_symbols().get_endmarker();
         }
 
         void parser_next_step() {
-            string top_symbol = stack_.top();
-            token current_token = current_tokens[current_step];
-            table table_ = parsing_table_.get_table();
+            const symbol_table& symbols = parsing_table_->get_symbols();
+            symbol_id top_symbol = stack_.top().symbol;
+            if(top_symbol == OPERATOR_STEP) {
+                expression_step();
+                return;
+            }
+            bool top_is_non_terminal = symbols.is_non_terminal(top_symbol);
 
-            while(!is_complete() && table_[top_symbol][current_token.token_type] == ERROR_TOKEN) {
-                errors.push_back(error_message(current_token.token_type));
+            while(!is_complete() && top_is_non_terminal &&
+                    parsing_table_->get_cell(top_symbol, token_type_at(current_step)) == ERROR_ENTRY) {
+                errors.push_back(error_message(token_type_at(current_step)));
                 jump();
-                if(current_step < current_tokens.size()) {
-                    current_token = current_tokens[current_step];
-                }
             }
 
             if(!is_complete()) {
-                auto terminals = parsing_table_.get_terminals();
+                symbol_id current_type = token_type_at(current_step);
 
-                if(top_symbol == current_token.token_type) {
+                if(top_symbol == current_type) {
+                    string_view value = input_tokens[current_step - window_base].value(source);
+                    if(events) {
+                        events->terminal(top_symbol, value);
+                    } else {
+                        ast.set_token(stack_.top().node, value);
+                    }
+                    matched_tokens++;
                     stack_.pop();
+                    if(events) {
+                        fire_exits();
+                    }
                     jump();
-                } else if(find(terminals.begin(), terminals.end(), top_symbol) != terminals.end() &&
-                            find(terminals.begin(), terminals.end(), current_token.token_type) != terminals.end()) {
-                    errors.push_back(error_message(current_token.token_type));
+                } else if(!top_is_non_terminal) {
+                    errors.push_back(error_message(current_type));
                     jump();
+                } else if(hands_over(top_symbol)) {
+                    node_id entry = stack_.top().node;
+                    stack_.pop();
+                    begin_expression(entry);
                 } else {
-                    auto prod_rule = parsing_table_.get_entry(top_symbol, current_token.token_type);
-                    auto productions = parsing_table_.get_productions();
-                    auto req_rule = productions[prod_rule.first].get_rules()[prod_rule.second];
-                    auto entities = req_rule.get_entities();
-                    reverse(entities.begin(), entities.end());
+                    auto prod_rule = parsing_table_->get_entry(top_symbol, current_type);
+                    const auto& entities = parsing_table_->get_productions()[prod_rule.first].get_rules()[prod_rule.second].get_entities();
+                    node_id parent_node = stack_.top().node;
                     stack_.pop();
-                    
-                    for(auto& entity : entities) {
-                        if(entity != EPSILON) {
-                            stack_.push(entity);
+
+                    const node_id* kids = nullptr;
+                    if(events) {
+                        events->enter(top_symbol);
+                        // exits of one symbol in tail position share an entry
+                        if(stack_.top().symbol == top_symbol && stack_.top().node != NO_NODE) {
+                            stack_.top().node++;
+                        } else {
+                            stack_.push({top_symbol, 1});
                         }
+                    } else {
+                        // the kids of a node are added together, so they take one range
+                        for(symbol_id entity : entities) {
+                            ast.add_kid(parent_node, entity, symbols.get_name(entity), !symbols.is_terminal(entity));
+                        }
+                        kids = ast.kids(parent_node).begin();
                     }
-                    history.push_back((prod_rule.first << 16U) ^ prod_rule.second);
-                }
-            }
-        }
-
-        void build_tree() {
-            stack<shared_ptr<parsing_node>> parsing_node_stack;
-            parsing_node_stack.push(ast);
-            
-            auto productions = parsing_table_.get_productions();
-            auto terminals = parsing_table_.get_terminals();
-            auto non_terminals = parsing_table_.get_non_terminals();
-
-            for(unsigned int value : get_history()) {        
-                unsigned int left = value >> 16U;
-                unsigned int right = value ^ (left << 16U);
-                auto prod_rule = std::make_pair(left, right);
-                auto req_prod = productions[prod_rule.first];
-                auto req_rule = req_prod.get_rules()[prod_rule.second];
-                auto parent = req_prod.get_parent();
-                auto entities = req_rule.get_entities();
-                
-                shared_ptr<parsing_node> parent_node = parsing_node_stack.top();
-
-                for(auto& entity : entities) {
-                    shared_ptr<parsing_node> kid_node = make_shared<parsing_node>();
-                    kid_node->token_type = entity;
-                    if(find(terminals.begin(), terminals.end(), entity) != terminals.end()) {
-                        kid_node->is_epsilon = false;
+                    for(size_t i = entities.size(); i-- > 0;) {
+                        if(entities[i] != symbols.get_epsilon()) {
+                            stack_.push({entities[i], kids ? kids[i] : NO_NODE});
+                        }
                     }
-                    parent_node->kids.push_back(kid_node);
-                }
-
-                parsing_node_stack.pop();
-
-                reverse(parent_node->kids.begin(), parent_node->kids.end());
-                for(shared_ptr<parsing_node>& kid_node : parent_node->kids) {
-                    if(find(non_terminals.begin(), non_terminals.end(), kid_node->token_type) != non_terminals.end()) {
-                        parsing_node_stack.push(kid_node);
+                    if(keep_history) {
+                        history.push_back((prod_rule.first << 16U) ^ prod_rule.second);
+                    }
+                    if(events) {
+                        fire_exits();
                     }
                 }
-                reverse(parent_node->kids.begin(), parent_node->kids.end());
             }
         }
 
         void remove_epsilon_node() {
-            DFS(ast);
-            remove(ast);
+            ast.remove_epsilon_node();
         }
 
         void remove_one_kid_node() {
-            remove_kid(ast, nullptr);
+            ast.remove_one_kid_node();
         }
 
-        void print_node(ofstream& ofs) {
-            vector<token> tokens = input_tokens;
-            int index = 0;
-            set(ast, tokens, index);
-            ast->print(ofs);
+        // removes epsilon subtrees and single-kid chains in one pass
+        void reduce_tree() {
+            ast.reduce();
         }
 
-        string gen_bracket(shared_ptr<parsing_node> node) {
-            auto& terminals = parsing_table_.get_terminals();
-            string str = "( ";
-            for(shared_ptr<parsing_node>& kid_node : node->kids) {
-                if(find(terminals.begin(), terminals.end(), kid_node->token_type) != terminals.end()) {
-                    if(kid_node->value == "(") {
-                        str += "\\( ";
-                    } else if(kid_node->value == ")") {
-                        str += "\\) ";
-                    } else {
-                        str += kid_node->value + " ";
-                    }
-                } else {
-                    str += gen_bracket(kid_node);
-                }
-                
-            }
-            return str + ") ";
+        void print_node(ostream& os) {
+            ast.print(os);
         }
 
-        void print_bracket(ofstream& ofs) {
-            ofs << gen_bracket(ast);
+        void print_bracket(ostream& os) {
+            ast.print_bracket(parsing_table_->get_symbols(), os);
         }
 
-        void set_input_tokens(vector<token> tokens) {
+        // any of the full tree, the reduced tree, the bracket form and the
+        // binary reduced tree (.ast) in one walk, leaving the tree as it is;
+        // null streams are skipped
+        bool emit(ostream* full, ostream* reduced, ostream* bracket, ostream* binary = nullptr) const {
+            return ast.emit(parsing_table_->get_symbols(), source, full, reduced, bracket, binary);
+        }
+
+        const parsing_tree& get_tree() const {return ast;}
+
+        // hands the tree over, the parser needs restart() before the next parse
+        parsing_tree release_tree() {
+            return std::move(ast);
+        }
+
+        // spans into source, which must outlive the parser's use of the tree
+        void set_input(string_view source, vector<token_span> tokens) {
+            next_tokens = nullptr;
+            this->source = source;
             input_tokens = std::move(tokens);
         }
 
+        // Stream mode: the parse pulls its tokens, spans into source, as it
+        // reaches them. next_tokens(window) replaces window by the tokens
+        // that follow and leaves it empty at the end of the input. Only the
+        // current window is held, so one stream serves one restart().
+        void set_input_stream(string_view source, function<void(vector<token_span>&)> next_tokens) {
+            this->source = source;
+            input_tokens.clear();
+            this->next_tokens = std::move(next_tokens);
+        }
+
         void restart() {
             while(!stack_.empty()) {
                 stack_.pop();
             }
-            stack_.push(STRING_ENDMARKER);
-            stack_.push(start_symbol);
+            const symbol_table& symbols = parsing_table_->get_symbols();
             current_step = 0;
-            current_tokens = input_tokens;
-            current_tokens.emplace_back(STRING_ENDMARKER, STRING_ENDMARKER);
-            ast = make_shared<parsing_node>();
-            ast->token_type = start_symbol;
-            ast->value = start_symbol;
+            matched_tokens = 0;
+            window_base = 0;
+            input_done = !next_tokens;
+            pull_tokens();
+            history.clear();
+            errors.clear();
+            expressions.clear();
+            operands.clear();
+            operators.clear();
+            ast.clear();
+            stack_.push({symbols.get_endmarker(), NO_NODE});
+            const tree_shape& shape = parsing_table_->get_shape();
+            events = user_events;
+            if(!events && use_shape && !shape.empty()) {
+                builder.reset(ast, symbols, shape);
+                events = &builder;
+            }
+            if(events) {
+                stack_.push({start_symbol, NO_NODE});
+                return;
+            }
+            ast.reserve(input_tokens.size() * 4 + 1);
+            stack_.push({start_symbol, ast.set_root(start_symbol, symbols.get_name(start_symbol))});
         }
 
-        void set_start_symbol(string symbol) {
-            start_symbol = std::move(symbol);
+        void set_start_symbol(symbol_id symbol) {
+            start_symbol = symbol;
         }
 
         void set_parsing_table(parsing_table table) {
+            parsing_table_ = make_shared<const parsing_table>(std::move(table));
+        }
+
+        void set_parsing_table(shared_ptr<const parsing_table> table) {
             parsing_table_ = std::move(table);
         }
 
-        const vs& get_errors() {return errors;}
+        const vs& get_errors() const {return errors;}
     };
 }
\ No newline at end of file
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "parsing_table.h"
+#include <map>
+#include <iomanip>
+
+using namespace std;
+
+namespace xd {
+    // name as a C++ string literal
+    string quote_name(const string& name) {
+        string quoted = "\"";
+        for(char c : name) {
+            if(c == '"' || c == '\\') {
+                quoted += '\\';
+            }
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Writes the C++ source of a parser for the grammar of table: a class
+    // class_name with the symbols, the rule bodies and the start symbol in
+    // constexpr arrays and the table folded into a switch per non-terminal.
+    // It runs the loop of parser (without events, precedence or shape) and
+    // builds the same trees with the same errors, but reads no grammar.
+    void generate_parser(const parsing_table& table, symbol_id start_symbol, uint64_t grammar_hash,
+                         const string& grammar_name, const string& class_name, ostream& os) {
+        const symbol_table& symbols = table.get_symbols();
+        const vprod& productions = table.get_productions();
+        const size_t terminal_count = symbols.get_terminal_count();
+        const size_t non_terminal_count = symbols.get_non_terminal_count();
+
+        // rules numbered in production order
+        vector<size_t> prod_first_rule;
+        vsym entities;
+        vector<size_t> rule_begin;
+        vs rule_text;
+        for(const auto& prod : productions) {
+            prod_first_rule.push_back(rule_begin.size());
+            for(const auto& rule : prod.get_rules()) {
+                rule_begin.push_back(entities.size());
+                entities.insert(entities.end(), rule.get_entities().begin(), rule.get_entities().end());
+                string text = symbols.get_name(prod.get_parent()) + " :";
+                for(symbol_id entity : rule.get_entities()) {
+                    text += " " + symbols.get_name(entity);
+                }
+                rule_text.push_back(std::move(text));
+            }
+        }
+        rule_begin.push_back(entities.size());
+
+        os << "// Generated by ll1_codegen from " << grammar_name << ", do not edit.\n";
+        os << "#pragma once\n\n";
+        os << "#include \"lexer.h\"\n";
+        os << "#include \"parsing_tree.h\"\n\n";
+        os << "using namespace std;\n\n";
+        os << "namespace xd {\n";
+        os << "    // LL(1) parser for " << grammar_name << " with the parsing table folded into\n";
+        os << "    // select_rule(); builds the same trees as parser with that grammar.\n";
+        os << "    class " << class_name << " {\n";
+        os << "        public:\n\n";
+        os << "        static constexpr uint64_t GRAMMAR_HASH = 0x" << hex << setw(16) << setfill('0') << grammar_hash << dec << setfill(' ') << "ULL;\n";
+        os << "        static constexpr symbol_id TERMINAL_COUNT = " << terminal_count << ";\n";
+        os << "        static constexpr symbol_id NON_TERMINAL_COUNT = " << non_terminal_count << ";\n";
+        os << "        static constexpr symbol_id ENDMARKER = " << symbols.get_endmarker() << ";\n";
+        os << "        static constexpr symbol_id EPSILON_SYMBOL = " << symbols.get_epsilon() << ";\n";
+        os << "        static constexpr symbol_id START_SYMBOL = " << start_symbol << "; // " << symbols.get_name(start_symbol) << "\n\n";
+        os << "        private:\n\n";
+
+        os << "        // name of every symbol id up to EPSILON_SYMBOL\n";
+        os << "        static constexpr string_view NAMES[] = {";
+        for(symbol_id id = 0; id <= symbols.get_epsilon(); id++) {
+            os << (id % 8 == 0 ? "\n            " : " ") << quote_name(symbols.get_name(id)) << ",";
+        }
+        os << "\n        };\n\n";
+
+        os << "        // bodies of all rules, rule r is ENTITIES[RULE_BEGIN[r], RULE_BEGIN[r + 1])\n";
+        os << "        static constexpr symbol_id ENTITIES[] = {";
+        for(size_t no = 0; no < entities.size(); no++) {
+            os << (no % 16 == 0 ? "\n            " : " ") << entities[no] << ",";
+        }
+        os << "\n        };\n\n";
+        os << "        static constexpr uint32_t RULE_BEGIN[] = {";
+        for(size_t no = 0; no < rule_begin.size(); no++) {
+            os << (no % 16 == 0 ? "\n            " : " ") << rule_begin[no] << ",";
+        }
+        os << "\n        };\n\n";
+        os << "        static constexpr uint32_t NO_RULE = ~0U;\n\n";
+
+        os << "        // rule that expands non_terminal on token, NO_RULE for an error\n";
+        os << "        static uint32_t select_rule(symbol_id non_terminal, symbol_id token) {\n";
+        os << "            switch(non_terminal) {\n";
+        for(symbol_id non_terminal = static_cast<symbol_id>(terminal_count); non_terminal < terminal_count + non_terminal_count; non_terminal++) {
+            // terminals of every rule of the row, in rule order
+            map<size_t, vsym> terminals_of;
+            for(symbol_id terminal = 0; terminal < terminal_count; terminal++) {
+                unsigned int cell = table.get_cell(non_terminal, terminal);
+                if(cell != ERROR_ENTRY) {
+                    auto entry = table.get_entry(non_terminal, terminal);
+                    terminals_of[prod_first_rule[entry.first] + entry.second].push_back(terminal);
+                }
+            }
+            if(terminals_of.empty()) {
+                continue;
+            }
+            os << "                case " << non_terminal << ": // " << symbols.get_name(non_terminal) << "\n";
+            os << "                    switch(token) {\n";
+            for(const auto& [rule, terminals] : terminals_of) {
+                os << "                        ";
+                for(symbol_id terminal : terminals) {
+                    os << "case " << terminal << ": ";
+                }
+                os << "return " << rule << "; // " << rule_text[rule] << "\n";
+            }
+            os << "                    }\n";
+            os << "                    break;\n";
+        }
+        os << "            }\n";
+        os << "            return NO_RULE;\n";
+        os << "        }\n\n";
+
+        os << R"(        struct stack_entry {
+            symbol_id symbol;
+            node_id node;
+        };
+
+        string_view source;
+        vector<token_span> input_tokens;
+        size_t current_step{};
+        vector<stack_entry> stack_;
+        parsing_tree ast;
+        vs errors;
+
+        symbol_id token_type_at(size_t step) const {
+            return step < input_tokens.size() ? input_tokens[step].token_type : ENDMARKER;
+        }
+
+        bool is_complete() const {
+            return current_step == input_tokens.size() + 1 || stack_.back().symbol == ENDMARKER;
+        }
+
+        void jump() {
+            if(!is_complete()) {
+                current_step++;
+            }
+        }
+
+        void parser_next_step() {
+            symbol_id top_symbol = stack_.back().symbol;
+            bool top_is_non_terminal = top_symbol >= TERMINAL_COUNT;
+            uint32_t rule = NO_RULE;
+
+            while(!is_complete() && top_is_non_terminal &&
+                    (rule = select_rule(top_symbol, token_type_at(current_step))) == NO_RULE) {
+                errors.push_back("parser: error at symbol: " + string(NAMES[token_type_at(current_step)]));
+                jump();
+            }
+            if(is_complete()) {
+                return;
+            }
+
+            symbol_id current_type = token_type_at(current_step);
+            if(top_symbol == current_type) {
+                ast.set_token(stack_.back().node, input_tokens[current_step].value(source));
+                stack_.pop_back();
+                jump();
+            } else if(!top_is_non_terminal) {
+                errors.push_back("parser: error at symbol: " + string(NAMES[current_type]));
+                jump();
+            } else {
+                node_id parent_node = stack_.back().node;
+                stack_.pop_back();
+                // the kids of a node are added together, so they take one range
+                for(uint32_t no = RULE_BEGIN[rule]; no < RULE_BEGIN[rule + 1]; no++) {
+                    symbol_id entity = ENTITIES[no];
+                    ast.add_kid(parent_node, entity, NAMES[entity], entity >= TERMINAL_COUNT);
+                }
+                const node_id* kids = ast.kids(parent_node).begin();
+                for(uint32_t no = RULE_BEGIN[rule + 1]; no-- > RULE_BEGIN[rule];) {
+                    if(ENTITIES[no] != EPSILON_SYMBOL) {
+                        stack_.push_back({ENTITIES[no], kids[no - RULE_BEGIN[rule]]});
+                    }
+                }
+            }
+        }
+
+        public:
+
+        // symbols of the grammar, for the lexer and the bracket and .ast outputs
+        static const symbol_table& get_symbols() {
+            static const symbol_table symbols(
+                vs(begin(NAMES), begin(NAMES) + ENDMARKER),
+                vs(begin(NAMES) + TERMINAL_COUNT, begin(NAMES) + TERMINAL_COUNT + NON_TERMINAL_COUNT));
+            return symbols;
+        }
+
+        // spans into source, which must outlive the parser's use of the tree
+        void set_input(string_view source, vector<token_span> tokens) {
+            this->source = source;
+            input_tokens = std::move(tokens);
+        }
+
+        void parse() {
+            current_step = 0;
+            errors.clear();
+            ast.clear();
+            ast.reserve(input_tokens.size() * 4 + 1);
+            stack_.clear();
+            stack_.push_back({ENDMARKER, NO_NODE});
+            stack_.push_back({START_SYMBOL, ast.set_root(START_SYMBOL, NAMES[START_SYMBOL])});
+            while(!is_complete()) {
+                parser_next_step();
+            }
+        }
+
+        // see parser::emit()
+        bool emit(ostream* full, ostream* reduced, ostream* bracket, ostream* binary = nullptr) const {
+            return ast.emit(get_symbols(), source, full, reduced, bracket, binary);
+        }
+
+        const parsing_tree& get_tree() const {return ast;}
+
+        parsing_tree release_tree() {
+            return std::move(ast);
+        }
+
+        const vs& get_errors() const {return errors;}
+    };
+}
+)";
+    }
+}
@@ -2,90 +2,162 @@
 
 #include <unordered_map>
 #include <string>
+#include <numeric>
 #include "utils.h"
 
 using namespace std;
 
 namespace xd {
-    using table = unordered_map<string, unordered_map<string, string>>;
+    // dense [non_terminal_no][terminal_id] table, each cell packs (prod_no << 16) ^ rule_no
+    using table = vector<unsigned int>;
 
-    const string ERROR_TOKEN = "__error__";
+    const unsigned int ERROR_ENTRY = ~0U;
 
     class parsing_table {
         table table_;
 
+        // Row displacement (comb) form of table_, built with set_compressed():
+        // the rows overlap in packed, row r starting at row_base[r]. The cell
+        // of row r and terminal t is the slot row_base[r] + t when the slot
+        // belongs to r, an error otherwise. Per-row default entries would pack
+        // tighter but turn error cells into expansions, which moves the errors
+        // the parser reports.
+        struct packed_cell {
+            uint32_t row;
+            unsigned int entry;
+        };
+        static constexpr uint32_t NO_ROW = ~0U;
+
+        vector<uint32_t> row_base;
+        vector<packed_cell> packed;
+        bool compressed = false;
+
         symbols_table firsts;
         symbols_table follows;
         vprod productions;
-        vs terminals;
-        vs non_terminals;
+        symbol_table symbols;
+        operator_precedence precedence;
+        tree_shape shape;
         vs errors;
 
-        string error_message(string prod, string symbol) {
-            return "parsing table: duplicate entry - prod: " + prod + " - symbol: " + symbol;
+        string error_message(symbol_id prod, symbol_id symbol) {
+            return "parsing table: duplicate entry - prod: " + symbols.get_name(prod) + " - symbol: " + symbols.get_name(symbol);
         }
 
-        public:
+        void set_cell(size_t prod_no, size_t rule_no, symbol_id parent, symbol_id symbol) {
+            unsigned int& entry = table_[symbols.non_terminal_no(parent) * symbols.get_terminal_count() + symbol];
+            if(entry != ERROR_ENTRY) {
+                errors.push_back(error_message(parent, symbol));
+            }
 
-        parsing_table() = default;
-        parsing_table(vs terminals, vs non_terminals) : terminals(std::move(terminals)), non_terminals(std::move(non_terminals)) {
-            this->terminals.push_back(STRING_ENDMARKER);
+            entry = static_cast<unsigned int>((prod_no << 16U) ^ rule_no);
         }
 
-        void build_tables() {
-            for(auto& non_terminal : non_terminals) {
-                for(auto& terminal : terminals) {
-                    table_[non_terminal][terminal] = ERROR_TOKEN;
+        // Places the rows with most entries first, each at the lowest base
+        // where all its entries land on free slots. A row that does not fit
+        // within max_tries bases goes behind all placed rows, which keeps
+        // packing tables with crowded rows linear; small tables are searched
+        // in full.
+        void pack_table() {
+            row_base.clear();
+            packed.clear();
+            if(!compressed || table_.empty()) {
+                return;
+            }
+            const size_t terminal_count = symbols.get_terminal_count();
+            const size_t row_count = table_.size() / terminal_count;
+
+            vector<vector<uint32_t>> columns(row_count);
+            for(size_t row = 0; row < row_count; row++) {
+                for(size_t terminal = 0; terminal < terminal_count; terminal++) {
+                    if(table_[row * terminal_count + terminal] != ERROR_ENTRY) {
+                        columns[row].push_back(static_cast<uint32_t>(terminal));
+                    }
                 }
             }
+            vector<uint32_t> order(row_count);
+            iota(order.begin(), order.end(), 0);
+            stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return columns[a].size() > columns[b].size();
+            });
+
+            // every base + terminal stays inside packed, a row without
+            // entries keeps base 0 and never owns a slot
+            row_base.assign(row_count, 0);
+            packed.assign(terminal_count, {NO_ROW, ERROR_ENTRY});
+            const size_t max_tries = max<size_t>(terminal_count, 1024);
+            size_t first_free = 0;
+            size_t used_end = 0;
+            for(uint32_t row : order) {
+                const auto& row_columns = columns[row];
+                if(row_columns.empty()) {
+                    break;
+                }
+                size_t base = first_free > row_columns[0] ? first_free - row_columns[0] : 0;
+                size_t tries = 0;
+                while(any_of(row_columns.begin(), row_columns.end(), [&](uint32_t terminal) {
+                    return base + terminal < packed.size() && packed[base + terminal].row != NO_ROW;
+                })) {
+                    base = ++tries < max_tries ? base + 1 : max<size_t>(used_end, row_columns[0]) - row_columns[0];
+                }
+                used_end = max(used_end, base + row_columns.back() + 1);
+                if(packed.size() < base + terminal_count) {
+                    packed.resize(base + terminal_count, {NO_ROW, ERROR_ENTRY});
+                }
+                row_base[row] = static_cast<uint32_t>(base);
+                for(uint32_t terminal : row_columns) {
+                    packed[base + terminal] = {row, table_[row * terminal_count + terminal]};
+                }
+                while(first_free < packed.size() && packed[first_free].row != NO_ROW) {
+                    first_free++;
+                }
+            }
+        }
+
+        public:
+
+        parsing_table() = default;
+        parsing_table(symbol_table symbols) : symbols(std::move(symbols)) {}
+
+        void build_tables() {
+            table_.assign(symbols.get_non_terminal_count() * symbols.get_terminal_count(), ERROR_ENTRY);
 
             for (size_t prod_no = 0; prod_no < productions.size(); prod_no++) {
-                string parent = productions[prod_no].get_parent();
+                symbol_id parent = productions[prod_no].get_parent();
                 auto& rules = productions[prod_no].get_rules();
 
                 for(size_t rule_no = 0; rule_no < rules.size(); rule_no++) {
-                    string first_entity = rules[rule_no].get_entities()[0];
-
-                    if(find(terminals.begin(), terminals.end(), first_entity) != terminals.end()) {
-                        string entry = table_[parent][first_entity];
-                        if(entry != ERROR_TOKEN) {
-                            errors.push_back(error_message(parent, first_entity));
-                        } 
-
-                        table_[parent][first_entity] = to_string((prod_no << 16U) ^ rule_no);
-                        
-                    } else if(find(non_terminals.begin(), non_terminals.end(), first_entity) != non_terminals.end()) {
-                        if(firsts.count(first_entity) != 0) {
-                            for(const auto& symbol : firsts[first_entity]) {
-                                if(symbol != EPSILON) {
-                                    string entry = table_[parent][symbol];
-                                    if(entry != ERROR_TOKEN) {
-                                        errors.push_back(error_message(parent, symbol));
-                                    } 
-
-                                    table_[parent][symbol] = to_string((prod_no << 16U) ^ rule_no);
-                                }
-                            }
-                        }
-                    } else if (first_entity == EPSILON) {
-                        if (follows.count(parent) != 0U) {
-                            for (auto &symbol : follows[parent]) {
-                                std::string entry = table_[parent][symbol];
-                                if (entry != ERROR_TOKEN) {
-                                errors.push_back(error_message(parent, symbol));
-                                }
-
-                                table_[parent][symbol] = to_string((prod_no << 16U) ^ rule_no);
+                    symbol_id first_entity = rules[rule_no].get_entities()[0];
+
+                    if(symbols.is_terminal(first_entity)) {
+                        set_cell(prod_no, rule_no, parent, first_entity);
+                    } else if(symbols.is_non_terminal(first_entity)) {
+                        firsts[first_entity].for_each([&](symbol_id symbol) {
+                            if(symbol != symbols.get_epsilon()) {
+                                set_cell(prod_no, rule_no, parent, symbol);
                             }
-                        }
+                        });
+                    } else if (first_entity == symbols.get_epsilon()) {
+                        follows[parent].for_each([&](symbol_id symbol) {
+                            set_cell(prod_no, rule_no, parent, symbol);
+                        });
                     }
                 } 
             }
+            pack_table();
         }
 
-        pair<unsigned int, unsigned int> get_entry (const string& terminal, const string& non_terminal) {
-            string entry = table_[terminal][non_terminal];
-            unsigned int value = static_cast<unsigned int>(stoul(entry));
+        unsigned int get_cell(symbol_id non_terminal, symbol_id terminal) const {
+            size_t row = symbols.non_terminal_no(non_terminal);
+            if(compressed) {
+                const packed_cell& cell = packed[row_base[row] + terminal];
+                return cell.row == row ? cell.entry : ERROR_ENTRY;
+            }
+            return table_[row * symbols.get_terminal_count() + terminal];
+        }
+
+        pair<unsigned int, unsigned int> get_entry(symbol_id non_terminal, symbol_id terminal) const {
+            unsigned int value = get_cell(non_terminal, terminal);
             unsigned int left = value >> 16U;
             unsigned int right = value ^ (left << 16U);
             return {left, right};
@@ -94,13 +166,29 @@ namespace xd {
         void set_firsts(symbols_table firsts) {this->firsts = std::move(firsts);}
         void set_follows (symbols_table follows) {this->follows = std::move(follows);}
         void set_productions (vprod productions) {this->productions = std::move(productions);}
-
-        const table& get_table() {return table_;}
-        const symbols_table& get_firsts() {return firsts;}
-        const symbols_table& get_follows() {return follows;}
-        const vprod& get_productions() {return productions;}
-        const vs& get_terminals() {return terminals;}
-        const vs& get_non_terminals() {return non_terminals;}
-        const vs& get_errors() {return errors;}
+        void set_table(table table_) {this->table_ = std::move(table_); pack_table();}
+        void set_precedence(operator_precedence precedence) {this->precedence = std::move(precedence);}
+        void set_shape(tree_shape shape) {this->shape = std::move(shape);}
+        // looks cells up in the row displacement form, see packed_cell
+        void set_compressed(bool compressed) {this->compressed = compressed; pack_table();}
+
+        bool is_compressed() const {return compressed;}
+        // bytes get_cell() reads from: the dense table, or the packed slots and row bases
+        size_t get_lookup_bytes() const {
+            if(compressed) {
+                return packed.size() * sizeof(packed_cell) + row_base.size() * sizeof(uint32_t);
+            }
+            return table_.size() * sizeof(unsigned int);
+        }
+        size_t get_packed_size() const {return packed.size();}
+
+        const table& get_table() const {return table_;}
+        const symbols_table& get_firsts() const {return firsts;}
+        const symbols_table& get_follows() const {return follows;}
+        const vprod& get_productions() const {return productions;}
+        const symbol_table& get_symbols() const {return symbols;}
+        const operator_precedence& get_precedence() const {return precedence;}
+        const tree_shape& get_shape() const {return shape;}
+        const vs& get_errors() const {return errors;}
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+#include "grammar.h"
+#include "tree_writer.h"
+#include "ast_file.h"
+#include <string_view>
+#include <ostream>
+#include <optional>
+#include <cstdint>
+
+using namespace std;
+
+namespace xd {
+
+    using node_id = uint32_t;
+    const node_id NO_NODE = ~0U;
+
+    // A node refers to its kids by a range of the tree's kid list, and to its
+    // value by a view into the source (terminals) or the symbol table.
+    // parent is the parent the node was added under, reductions do not
+    // update it. keep protects a one-kid node from being collapsed.
+    struct parsing_node {
+        symbol_id token_type{NO_SYMBOL};
+        bool is_epsilon{true};
+        string_view value;
+        uint32_t first_kid{};
+        uint32_t kid_count{};
+        node_id parent{NO_NODE};
+        bool keep{};
+    };
+
+    // Nodes of one AST in contiguous storage. Kids of a node are added all at
+    // once, so they take one range of kid_ids; reductions only shrink ranges
+    // or overwrite entries in place. clear() frees the whole tree in one go.
+    class parsing_tree {
+        vector<parsing_node> nodes;
+        vector<node_id> kid_ids;
+        node_id root{NO_NODE};
+
+        // explicit-stack frame, so walks are bounded by the tree rather than
+        // by the thread's stack
+        struct walk_frame {
+            node_id node;
+            uint32_t next_kid;
+            uint32_t kept;
+        };
+
+        // Post-order walk that rewrites kid ranges: leave(node, is_root) runs
+        // once the node's kids are done and returns the node that takes its
+        // place in the parent, NO_NODE to drop it.
+        template<typename leave_t>
+        void rewrite(leave_t leave) {
+            vector<walk_frame> frames{{root, 0, 0}};
+            while(!frames.empty()) {
+                walk_frame& frame = frames.back();
+                parsing_node& parent = nodes[frame.node];
+                if(frame.next_kid < parent.kid_count) {
+                    node_id kid_id = kid_ids[parent.first_kid + frame.next_kid++];
+                    frames.push_back({kid_id, 0, 0});
+                    continue;
+                }
+
+                parent.kid_count = frame.kept;
+                node_id replacement = leave(frame.node, frames.size() == 1);
+                frames.pop_back();
+                if(!frames.empty() && replacement != NO_NODE) {
+                    walk_frame& up = frames.back();
+                    kid_ids[nodes[up.node].first_kid + up.kept++] = replacement;
+                }
+            }
+        }
+
+        // a node derives a terminal if any of its kept kids does
+        node_id drop_epsilon(node_id node, bool is_root) {
+            if(nodes[node].kid_count != 0) {
+                nodes[node].is_epsilon = false;
+            }
+            return nodes[node].is_epsilon && !is_root ? NO_NODE : node;
+        }
+
+        node_id skip_one_kid(node_id node, bool is_root) {
+            if(!is_root && nodes[node].kid_count == 1 && !nodes[node].keep) {
+                return kid_ids[nodes[node].first_kid];
+            }
+            return node;
+        }
+
+        public:
+
+        // contiguous view of one node's kid ids
+        template<typename id_t>
+        struct kid_range {
+            id_t* first;
+            id_t* last;
+
+            id_t* begin() const {return first;}
+            id_t* end() const {return last;}
+            size_t size() const {return last - first;}
+            id_t& operator[](size_t i) const {return first[i];}
+        };
+
+        void clear() {
+            nodes.clear();
+            kid_ids.clear();
+            root = NO_NODE;
+        }
+
+        void reserve(size_t node_count) {
+            nodes.reserve(node_count);
+            kid_ids.reserve(node_count);
+        }
+
+        node_id add_node(symbol_id token_type, string_view value, bool is_epsilon) {
+            nodes.push_back({token_type, is_epsilon, value, 0, 0, NO_NODE, false});
+            return static_cast<node_id>(nodes.size() - 1);
+        }
+
+        node_id set_root(symbol_id token_type, string_view value) {
+            root = add_node(token_type, value, true);
+            return root;
+        }
+
+        // makes a node already in the tree the root, for trees built bottom-up
+        void set_root_node(node_id node) {
+            root = node;
+        }
+
+        // kids of a node must be added one after another, before any other
+        // node gets kids
+        node_id add_kid(node_id parent, symbol_id token_type, string_view value, bool is_epsilon) {
+            return attach_kid(parent, add_node(token_type, value, is_epsilon));
+        }
+
+        // adds a node that is already in the tree, e.g. an appended root, as
+        // the next kid of parent
+        node_id attach_kid(node_id parent, node_id kid) {
+            nodes[kid].parent = parent;
+            if(nodes[parent].kid_count == 0) {
+                nodes[parent].first_kid = static_cast<uint32_t>(kid_ids.size());
+            }
+            kid_ids.push_back(kid);
+            nodes[parent].kid_count++;
+            return kid;
+        }
+
+        // copies all nodes of another tree into this one and returns the id
+        // of its root, which is left without a parent
+        node_id append(const parsing_tree& other) {
+            const node_id node_base = static_cast<node_id>(nodes.size());
+            const uint32_t kid_base = static_cast<uint32_t>(kid_ids.size());
+            for(parsing_node node : other.nodes) {
+                node.first_kid += kid_base;
+                if(node.parent != NO_NODE) {
+                    node.parent += node_base;
+                }
+                nodes.push_back(node);
+            }
+            for(node_id kid : other.kid_ids) {
+                kid_ids.push_back(kid + node_base);
+            }
+            return other.root + node_base;
+        }
+
+        // Gives a matched terminal its lexeme. Its ancestors derive a
+        // terminal from now on, so is_epsilon is final once every terminal
+        // of the tree is matched.
+        void set_token(node_id node, string_view value) {
+            nodes[node].value = value;
+            mark_non_epsilon(nodes[node].parent);
+        }
+
+        // node and its ancestors derive a terminal
+        void mark_non_epsilon(node_id node) {
+            for(node_id up = node; up != NO_NODE && nodes[up].is_epsilon; up = nodes[up].parent) {
+                nodes[up].is_epsilon = false;
+            }
+        }
+
+        node_id get_root() const {return root;}
+        size_t size() const {return nodes.size();}
+
+        parsing_node& operator[](node_id node) {return nodes[node];}
+        const parsing_node& operator[](node_id node) const {return nodes[node];}
+
+        kid_range<node_id> kids(node_id node) {
+            node_id* first = kid_ids.data() + nodes[node].first_kid;
+            return {first, first + nodes[node].kid_count};
+        }
+
+        kid_range<const node_id> kids(node_id node) const {
+            const node_id* first = kid_ids.data() + nodes[node].first_kid;
+            return {first, first + nodes[node].kid_count};
+        }
+
+        // drops subtrees that derive no terminal
+        void remove_epsilon_node() {
+            rewrite([this](node_id node, bool is_root) {return drop_epsilon(node, is_root);});
+        }
+
+        // replaces every node below the root that has one kid by that kid,
+        // unless the node is marked keep
+        void remove_one_kid_node() {
+            rewrite([this](node_id node, bool is_root) {return skip_one_kid(node, is_root);});
+        }
+
+        // same tree as remove_epsilon_node() followed by remove_one_kid_node(),
+        // in one pass
+        void reduce() {
+            rewrite([this](node_id node, bool is_root) {
+                node_id kept = drop_epsilon(node, is_root);
+                return kept == NO_NODE ? NO_NODE : skip_one_kid(node, is_root);
+            });
+        }
+
+        void print(ostream& os) const {
+            emit(nullptr, &os, nullptr, nullptr);
+        }
+
+        void print_bracket(const symbol_table& symbols, ostream& os) const {
+            bracket_writer out(os);
+            vector<walk_frame> frames{{root, 0, 0}};
+            out.open();
+            while(!frames.empty()) {
+                walk_frame& frame = frames.back();
+                const parsing_node& parent = nodes[frame.node];
+                if(frame.next_kid == parent.kid_count) {
+                    out.close();
+                    frames.pop_back();
+                    continue;
+                }
+
+                node_id kid_id = kid_ids[parent.first_kid + frame.next_kid++];
+                if(symbols.is_terminal(nodes[kid_id].token_type)) {
+                    out.terminal(nodes[kid_id].value);
+                } else {
+                    out.open();
+                    frames.push_back({kid_id, 0, 0});
+                }
+            }
+        }
+
+        // emit() with the binary reduced tree (.ast) of source going to binary
+        bool emit(const symbol_table& symbols, string_view source, ostream* full, ostream* reduced, ostream* bracket,
+                  ostream* binary) const {
+            if(!binary) {
+                emit(&symbols, full, reduced, bracket);
+                return true;
+            }
+            ast_writer writer(*binary, symbols, source, ast_writer::FLAG_REDUCED);
+            emit(&symbols, full, reduced, bracket, &writer);
+            return writer.finish();
+        }
+
+        // Writes any subset of the tree as it is (full), the tree reduce()
+        // would make (reduced) and the bracket form of that reduced tree, in
+        // one pre-order walk and without changing the tree. The reduced tree
+        // can also go to a binary ast_writer, which the caller finishes. The
+        // reduced views rely on is_epsilon, see set_token(). symbols is only
+        // needed for the bracket form.
+        void emit(const symbol_table* symbols, ostream* full_os, ostream* reduced_os, ostream* bracket_os,
+                  ast_writer* ast = nullptr) const {
+            optional<vcps_writer> full;
+            optional<vcps_writer> reduced;
+            optional<bracket_writer> bracket;
+            if(full_os) full.emplace(*full_os);
+            if(reduced_os) reduced.emplace(*reduced_os);
+            if(bracket_os && symbols) bracket.emplace(*bracket_os);
+            const bool reduced_view = reduced || bracket || ast;
+
+            struct emit_frame {
+                node_id node;
+                uint32_t next_kid;
+                bool full_open;
+                bool reduced_open;
+                bool bracket_open;
+                bool ast_open;
+            };
+            vector<emit_frame> frames;
+
+            auto enter = [&](node_id id, bool is_root) {
+                const parsing_node& node = nodes[id];
+                emit_frame frame{id, 0, false, false, false, false};
+                if(full) {
+                    if(is_root) {
+                        full->root(node.value, node.kid_count);
+                    } else {
+                        full->kid(node.value, node.kid_count);
+                    }
+                    frame.full_open = node.kid_count != 0;
+                }
+
+                if(reduced_view && (is_root || !node.is_epsilon)) {
+                    size_t n_kids = 0;
+                    for(node_id kid_id : kids(id)) {
+                        n_kids += nodes[kid_id].is_epsilon ? 0 : 1;
+                    }
+                    // a node with one kid left is replaced by that kid
+                    if(is_root || n_kids != 1 || node.keep) {
+                        if(reduced) {
+                            if(is_root) {
+                                reduced->root(node.value, n_kids);
+                            } else {
+                                reduced->kid(node.value, n_kids);
+                            }
+                            frame.reduced_open = n_kids != 0;
+                        }
+                        if(ast) {
+                            if(is_root) {
+                                ast->root(node.token_type, node.value, n_kids);
+                            } else {
+                                ast->kid(node.token_type, node.value, n_kids);
+                            }
+                            frame.ast_open = n_kids != 0;
+                        }
+                        if(bracket) {
+                            if(symbols->is_terminal(node.token_type)) {
+                                bracket->terminal(node.value);
+                            } else {
+                                bracket->open();
+                                frame.bracket_open = true;
+                            }
+                        }
+                    }
+                }
+                frames.push_back(frame);
+            };
+
+            enter(root, true);
+            while(!frames.empty()) {
+                emit_frame& frame = frames.back();
+                const parsing_node& parent = nodes[frame.node];
+                if(frame.next_kid < parent.kid_count) {
+                    node_id kid_id = kid_ids[parent.first_kid + frame.next_kid++];
+                    // epsilon subtrees only show in the full tree
+                    if(full || !nodes[kid_id].is_epsilon) {
+                        enter(kid_id, false);
+                    }
+                    continue;
+                }
+
+                if(frame.full_open) full->close();
+                if(frame.reduced_open) reduced->close();
+                if(frame.bracket_open) bracket->close();
+                if(frame.ast_open) ast->close();
+                frames.pop_back();
+            }
+
+            if(full) full->finish();
+            if(reduced) reduced->finish();
+        }
+    };
+}
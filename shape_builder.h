@@ -0,0 +1,111 @@
+#pragma once
+
+#include "grammar.h"
+#include "parsing_tree.h"
+
+using namespace std;
+
+namespace xd {
+
+    // Receives a derivation as it is parsed: enter() when a non-terminal is
+    // expanded, terminal() when a token is matched and exit() once every
+    // symbol of the expansion is done, in the pre-order of the full tree
+    // without its EPSILON leaves.
+    struct parse_events {
+        virtual ~parse_events() = default;
+        virtual void enter(symbol_id) {}
+        virtual void terminal(symbol_id, string_view) {}
+        virtual void exit(symbol_id) {}
+    };
+
+    // Builds a parsing_tree from parse events, applying the SHAPE block of
+    // the grammar as the nodes are made: inlined symbols and dropped
+    // terminals never get a node, flatten inlines a symbol directly under a
+    // node of the same symbol, keep marks the node for the reduced view.
+    // Kids wait in pending until their node's exit(), so each node still
+    // has one kid range. With no directives the tree is the parser's.
+    class shape_builder : public parse_events {
+        struct frame {
+            // NO_NODE for an inlined symbol, whose kids go to the enclosing node
+            node_id node;
+            // symbol of the nearest enclosing node
+            symbol_id owner;
+            size_t kids_begin;
+            // terminals matched before the symbol was entered
+            size_t terminals_begin;
+        };
+
+        parsing_tree* tree{};
+        const symbol_table* symbols{};
+        const tree_shape* shape{};
+        vector<frame> frames;
+        vector<node_id> pending;
+        // terminals matched so far, dropped ones included
+        size_t terminals_seen{};
+
+        public:
+
+        // starts a new tree in tree
+        void reset(parsing_tree& tree, const symbol_table& symbols, const tree_shape& shape) {
+            this->tree = &tree;
+            this->symbols = &symbols;
+            this->shape = &shape;
+            tree.clear();
+            frames.clear();
+            pending.clear();
+            terminals_seen = 0;
+        }
+
+        void enter(symbol_id symbol) override {
+            if(frames.empty()) {
+                node_id root = tree->set_root(symbol, symbols->get_name(symbol));
+                (*tree)[root].keep = shape->has(symbol, tree_shape::KEEP);
+                frames.push_back({root, symbol, 0, terminals_seen});
+                return;
+            }
+
+            symbol_id owner = frames.back().owner;
+            if(shape->has(symbol, tree_shape::INLINE) || (owner == symbol && shape->has(symbol, tree_shape::FLATTEN))) {
+                frames.push_back({NO_NODE, owner, pending.size(), terminals_seen});
+                return;
+            }
+            node_id node = tree->add_node(symbol, symbols->get_name(symbol), true);
+            (*tree)[node].keep = shape->has(symbol, tree_shape::KEEP);
+            pending.push_back(node);
+            frames.push_back({node, symbol, pending.size(), terminals_seen});
+        }
+
+        void terminal(symbol_id symbol, string_view value) override {
+            terminals_seen++;
+            if(!shape->has(symbol, tree_shape::DROP)) {
+                pending.push_back(tree->add_node(symbol, value, false));
+            }
+        }
+
+        void exit(symbol_id) override {
+            frame done = frames.back();
+            frames.pop_back();
+            if(done.node == NO_NODE) {
+                return;
+            }
+
+            // a node that matched no terminal expanded to EPSILON, as in the
+            // parser's tree; one whose terminals were all dropped has no kids
+            if(pending.size() == done.kids_begin) {
+                if(terminals_seen == done.terminals_begin) {
+                    symbol_id epsilon = symbols->get_epsilon();
+                    pending.push_back(tree->add_node(epsilon, symbols->get_name(epsilon), true));
+                } else {
+                    (*tree)[done.node].is_epsilon = false;
+                }
+            }
+            for(size_t no = done.kids_begin; no < pending.size(); no++) {
+                tree->attach_kid(done.node, pending[no]);
+                if(!(*tree)[pending[no]].is_epsilon) {
+                    (*tree)[done.node].is_epsilon = false;
+                }
+            }
+            pending.resize(done.kids_begin);
+        }
+    };
+}
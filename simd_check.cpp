@@ -0,0 +1,118 @@
+#include <bits/stdc++.h>
+
+#include "simd_scan.h"
+
+using namespace std;
+using namespace xd;
+
+// Checks the SSE2 and AVX2 run scanners against the scalar loop: runs that
+// start at every offset of a 32-byte block and end at every offset of the
+// following blocks, runs that end at the end of the buffer, and every byte
+// value as the stop byte in every lane. Each buffer is allocated to its exact
+// size, so a kernel that reads past the end shows up under -fsanitize=address.
+struct byte_set {
+    const char* name;
+    bool (*in_set)(uint8_t);
+    size_t (run_scanner::*skip)(string_view, size_t) const;
+    // all bytes in the set, runs are made of them
+    string members;
+};
+
+const char* isa_name(scan_isa isa) {
+    switch(isa) {
+    case scan_isa::AVX2: return "avx2";
+    case scan_isa::SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+int main()
+{
+    string all_bytes;
+    for(int c = 0; c < 256; c++) {
+        all_bytes += static_cast<char>(c);
+    }
+    auto members_of = [&](bool (*in_set)(uint8_t)) {
+        string members;
+        for(char c : all_bytes) {
+            if(in_set(static_cast<uint8_t>(c))) {
+                members += c;
+            }
+        }
+        return members;
+    };
+    const vector<byte_set> sets = {
+        {"space", is_space_byte, &run_scanner::skip_space, members_of(is_space_byte)},
+        {"word", is_word_byte, &run_scanner::skip_word, members_of(is_word_byte)},
+        {"string", is_string_byte, &run_scanner::skip_string_body, members_of(is_string_byte)},
+        {"comment", is_comment_byte, &run_scanner::skip_comment_body, members_of(is_comment_byte)},
+    };
+
+    const run_scanner scalar(scan_isa::SCALAR);
+    vector<run_scanner> vector_scanners;
+    for(scan_isa isa : {scan_isa::SSE2, scan_isa::AVX2}) {
+        run_scanner scanner(isa);
+        if(scanner.get_isa() == isa) {
+            vector_scanners.push_back(scanner);
+        } else {
+            cout << isa_name(isa) << ": not supported by this CPU, skipped\n";
+        }
+    }
+
+    size_t checks = 0;
+    size_t failures = 0;
+    // scans bytes from pos with every scanner, expecting end
+    auto check = [&](const byte_set& set, const string& bytes, size_t pos, size_t end) {
+        unique_ptr<char[]> exact(new char[bytes.size()]);
+        memcpy(exact.get(), bytes.data(), bytes.size());
+        string_view source(exact.get(), bytes.size());
+        size_t expected = (scalar.*set.skip)(source, pos);
+        if(expected != end && failures++ < 20) {
+            cout << "FAIL scalar " << set.name << ": size " << bytes.size() << " pos " << pos << " gives " << expected << ", not " << end << '\n';
+        }
+        for(const run_scanner& scanner : vector_scanners) {
+            size_t found = (scanner.*set.skip)(source, pos);
+            checks++;
+            if(found != expected && failures++ < 20) {
+                cout << "FAIL " << isa_name(scanner.get_isa()) << " " << set.name << ": size " << bytes.size()
+                     << " pos " << pos << " gives " << found << ", scalar " << expected << '\n';
+            }
+        }
+    };
+
+    for(const byte_set& set : sets) {
+        string stops;
+        for(char c : all_bytes) {
+            if(!set.in_set(static_cast<uint8_t>(c))) {
+                stops += c;
+            }
+        }
+
+        // a run of every length from every start offset, stopped by a
+        // non-member or by the end of the buffer
+        for(size_t pos = 0; pos < 32; pos++) {
+            for(size_t length = 0; length <= 96; length++) {
+                string run;
+                for(size_t no = 0; no < length; no++) {
+                    run += set.members[(pos + no * 7) % set.members.size()];
+                }
+                string prefix(pos, stops[0]);
+                check(set, prefix + run, pos, pos + length);
+                char stop = stops[(pos + length) % stops.size()];
+                check(set, prefix + run + stop + string(40, set.members[0]), pos, pos + length);
+            }
+        }
+
+        // every byte value in every lane of a 16- and a 32-byte block
+        for(size_t lane = 0; lane < 64; lane++) {
+            for(int c = 0; c < 256; c++) {
+                string bytes(64, set.members.back());
+                bytes[lane] = static_cast<char>(c);
+                check(set, bytes, 0, set.in_set(static_cast<uint8_t>(c)) ? bytes.size() : lane);
+            }
+        }
+    }
+
+    cout << checks << " vector scans compared, " << failures << " failures\n";
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define XD_HAS_X86_SIMD 1
+#endif
+
+using namespace std;
+
+namespace xd {
+    // Byte sets of the lexer runs that dominate typical input, in the C locale.
+    inline bool is_space_byte(uint8_t c) {return c == ' ' || (c >= '\t' && c <= '\r');}
+    inline bool is_word_byte(uint8_t c) {return (c >= '0' && c <= '9') || ((c | 0x20U) >= 'a' && (c | 0x20U) <= 'z');}
+    inline bool is_string_byte(uint8_t c) {return c != '"';}
+    inline bool is_comment_byte(uint8_t c) {return c != '\n' && c != '\r';}
+
+    enum class scan_isa {SCALAR, SSE2, AVX2};
+
+    // Each kernel returns the first position in [pos, size) whose byte is not
+    // in the kernel's set, or size.
+    using scan_kernel = size_t (*)(const uint8_t* bytes, size_t pos, size_t size);
+
+    template<bool (*in_set)(uint8_t)>
+    size_t scan_scalar(const uint8_t* bytes, size_t pos, size_t size) {
+        while(pos < size && in_set(bytes[pos])) {
+            pos++;
+        }
+        return pos;
+    }
+
+#ifdef XD_HAS_X86_SIMD
+    // bit i of the mask is set when byte i is in the set
+    __attribute__((target("sse2"))) inline uint32_t space_mask_sse2(__m128i x) {
+        __m128i offset = _mm_sub_epi8(x, _mm_set1_epi8('\t'));
+        __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8('\r' - '\t')), offset);
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(control, _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')))));
+    }
+
+    __attribute__((target("sse2"))) inline uint32_t word_mask_sse2(__m128i x) {
+        __m128i digit = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+        digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        __m128i letter = _mm_sub_epi8(_mm_or_si128(x, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(25)), letter);
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(digit, letter)));
+    }
+
+    __attribute__((target("sse2"))) inline uint32_t string_mask_sse2(__m128i x) {
+        return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')))) & 0xFFFFU;
+    }
+
+    __attribute__((target("sse2"))) inline uint32_t comment_mask_sse2(__m128i x) {
+        __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r')));
+        return ~static_cast<uint32_t>(_mm_movemask_epi8(stop)) & 0xFFFFU;
+    }
+
+    template<uint32_t (*mask_of)(__m128i), bool (*in_set)(uint8_t)>
+    __attribute__((target("sse2"))) size_t scan_sse2(const uint8_t* bytes, size_t pos, size_t size) {
+        while(pos + 16 <= size) {
+            uint32_t mask = mask_of(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + pos)));
+            if(mask != 0xFFFFU) {
+                return pos + __builtin_ctz(~mask);
+            }
+            pos += 16;
+        }
+        return scan_scalar<in_set>(bytes, pos, size);
+    }
+
+    __attribute__((target("avx2"))) inline uint32_t space_mask_avx2(__m256i x) {
+        __m256i offset = _mm256_sub_epi8(x, _mm256_set1_epi8('\t'));
+        __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8('\r' - '\t')), offset);
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(control, _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')))));
+    }
+
+    __attribute__((target("avx2"))) inline uint32_t word_mask_avx2(__m256i x) {
+        __m256i digit = _mm256_sub_epi8(x, _mm256_set1_epi8('0'));
+        digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+        __m256i letter = _mm256_sub_epi8(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(25)), letter);
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(digit, letter)));
+    }
+
+    __attribute__((target("avx2"))) inline uint32_t string_mask_avx2(__m256i x) {
+        return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"'))));
+    }
+
+    __attribute__((target("avx2"))) inline uint32_t comment_mask_avx2(__m256i x) {
+        __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')));
+        return ~static_cast<uint32_t>(_mm256_movemask_epi8(stop));
+    }
+
+    template<uint32_t (*mask_of)(__m256i), bool (*in_set)(uint8_t)>
+    __attribute__((target("avx2"))) size_t scan_avx2(const uint8_t* bytes, size_t pos, size_t size) {
+        while(pos + 32 <= size) {
+            uint32_t mask = mask_of(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + pos)));
+            if(mask != 0xFFFFFFFFU) {
+                return pos + __builtin_ctz(~mask);
+            }
+            pos += 32;
+        }
+        return scan_scalar<in_set>(bytes, pos, size);
+    }
+#endif
+
+    inline scan_isa detect_scan_isa() {
+#ifdef XD_HAS_X86_SIMD
+        static const scan_isa isa = [] {
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx2")) {
+                return scan_isa::AVX2;
+            }
+            if(__builtin_cpu_supports("sse2")) {
+                return scan_isa::SSE2;
+            }
+            return scan_isa::SCALAR;
+        }();
+        return isa;
+#else
+        return scan_isa::SCALAR;
+#endif
+    }
+
+    // Skips whitespace, identifier, string body and comment body runs with
+    // the widest kernels the CPU supports. Every kernel stops on the same
+    // byte as the scalar loop, so tokens do not depend on the choice.
+    class run_scanner {
+        scan_isa isa{scan_isa::SCALAR};
+        scan_kernel space{scan_scalar<is_space_byte>};
+        scan_kernel word{scan_scalar<is_word_byte>};
+        scan_kernel string_body{scan_scalar<is_string_byte>};
+        scan_kernel comment_body{scan_scalar<is_comment_byte>};
+
+        public:
+        run_scanner() : run_scanner(detect_scan_isa()) {}
+
+        explicit run_scanner(scan_isa requested) {
+#ifdef XD_HAS_X86_SIMD
+            if(requested == scan_isa::AVX2 && detect_scan_isa() == scan_isa::AVX2) {
+                isa = scan_isa::AVX2;
+                space = scan_avx2<space_mask_avx2, is_space_byte>;
+                word = scan_avx2<word_mask_avx2, is_word_byte>;
+                string_body = scan_avx2<string_mask_avx2, is_string_byte>;
+                comment_body = scan_avx2<comment_mask_avx2, is_comment_byte>;
+            } else if(requested != scan_isa::SCALAR && detect_scan_isa() != scan_isa::SCALAR) {
+                isa = scan_isa::SSE2;
+                space = scan_sse2<space_mask_sse2, is_space_byte>;
+                word = scan_sse2<word_mask_sse2, is_word_byte>;
+                string_body = scan_sse2<string_mask_sse2, is_string_byte>;
+                comment_body = scan_sse2<comment_mask_sse2, is_comment_byte>;
+            }
+#else
+            (void)requested;
+#endif
+        }
+
+        size_t skip_space(string_view source, size_t pos) const {
+            return space(reinterpret_cast<const uint8_t*>(source.data()), pos, source.size());
+        }
+
+        size_t skip_word(string_view source, size_t pos) const {
+            return word(reinterpret_cast<const uint8_t*>(source.data()), pos, source.size());
+        }
+
+        size_t skip_string_body(string_view source, size_t pos) const {
+            return string_body(reinterpret_cast<const uint8_t*>(source.data()), pos, source.size());
+        }
+
+        size_t skip_comment_body(string_view source, size_t pos) const {
+            return comment_body(reinterpret_cast<const uint8_t*>(source.data()), pos, source.size());
+        }
+
+        scan_isa get_isa() const {return isa;}
+    };
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "parser.h"
+#include "utils.h"
+
+using namespace std;
+
+namespace xd {
+    // Builds the LL(1) table of grammar text in the grammar.dat format.
+    // On failure errors holds the grammar reader's message, or one message
+    // per conflict of the table.
+    bool build_parsing_table(string_view grammar_text, parsing_table& parsing_table_, symbol_id& start_symbol, vs& errors) {
+        errors.clear();
+        grammar_parser grammar_parser;
+        if(!grammar_parser.parse(grammar_text)) {
+            errors.push_back(grammar_parser.get_error());
+            return false;
+        }
+
+        auto productions = grammar_parser.get_grammar();
+        const auto& symbols = grammar_parser.get_symbols();
+        start_symbol = symbols.get_id(grammar_parser.get_start_symbol());
+
+        auto nullables = calc_nullables(productions, symbols);
+        auto firsts = calc_firsts(productions, symbols, nullables);
+        auto follows = calc_follows(productions, symbols, nullables, firsts, start_symbol);
+
+        parsing_table_ = parsing_table(symbols);
+        parsing_table_.set_firsts(firsts);
+        parsing_table_.set_follows(follows);
+        parsing_table_.set_productions(productions);
+        parsing_table_.set_precedence(grammar_parser.get_precedence());
+        parsing_table_.set_shape(grammar_parser.get_shape());
+        parsing_table_.build_tables();
+
+        errors = parsing_table_.get_errors();
+        return errors.empty();
+    }
+
+    // tree and diagnostics of one parse: the lexer error, or the parser
+    // errors; the tree is only complete without errors
+    struct parse_result {
+        parsing_tree tree;
+        vs errors;
+
+        bool ok() const {return errors.empty();}
+    };
+
+    // Library entry point: a grammar built once from text or a table, then
+    // sources parsed straight from memory. parse() keeps no state, so one
+    // source_parser can serve several threads. Tree values are views into
+    // the source and into the grammar's symbol table, which must both
+    // outlive the tree.
+    class source_parser {
+        shared_ptr<const parsing_table> parsing_table_;
+        lexer_dfa dfa;
+        symbol_id start_symbol{NO_SYMBOL};
+        bool use_precedence{};
+        bool use_shape{};
+        vs errors;
+
+        public:
+
+        // grammar.dat text; false with get_errors() if it is not LL(1)
+        bool load_grammar(string_view grammar_text) {
+            parsing_table table;
+            symbol_id start;
+            if(!build_parsing_table(grammar_text, table, start, errors)) {
+                return false;
+            }
+            set_grammar(make_shared<const parsing_table>(std::move(table)), start);
+            return true;
+        }
+
+        // an already built table, e.g. one read from a grammar_cache
+        void set_grammar(shared_ptr<const parsing_table> table, symbol_id start) {
+            parsing_table_ = std::move(table);
+            dfa = lexer_dfa(parsing_table_->get_symbols());
+            start_symbol = start;
+            errors.clear();
+        }
+
+        parse_result parse(string_view source) const {
+            parse_result result;
+            const symbol_table& symbols = parsing_table_->get_symbols();
+            lexer lexer;
+            vector<token_span> tokens;
+            size_t pos = 0;
+            token_span token_;
+            while((token_ = lexer.get_token(source, pos, dfa)).token_type != symbols.get_eof()) {
+                if(token_.token_type == symbols.get_comment()) {
+                    continue;
+                }
+                if(token_.token_type == symbols.get_error()) {
+                    result.errors.push_back(lexer.get_error());
+                    return result;
+                }
+                tokens.push_back(token_);
+            }
+
+            parser ll1_parser;
+            ll1_parser.set_input(source, std::move(tokens));
+            ll1_parser.set_parsing_table(parsing_table_);
+            ll1_parser.set_start_symbol(start_symbol);
+            ll1_parser.set_precedence(use_precedence);
+            ll1_parser.set_shape(use_shape);
+            ll1_parser.restart();
+            while(!ll1_parser.is_complete()) {
+                ll1_parser.parser_next_step();
+            }
+            result.errors = ll1_parser.get_errors();
+            result.tree = ll1_parser.release_tree();
+            return result;
+        }
+
+        // see parser::set_precedence()
+        void set_precedence(bool use) {
+            use_precedence = use;
+        }
+
+        // see parser::set_shape()
+        void set_shape(bool use) {
+            use_shape = use;
+        }
+
+        bool is_loaded() const {return parsing_table_ != nullptr;}
+        const symbol_table& get_symbols() const {return parsing_table_->get_symbols();}
+        const vs& get_errors() const {return errors;}
+    };
+}
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Stress check for the tree walks: generates pathologically deep .vc inputs,
+# parses them with a 512 KB stack and compares the outputs with a run under
+# the caller's stack. A walk that recurses again crashes the small-stack run.
+#
+# usage: stress_deep.sh [main_binary] [grammar_file]
+# (main_binary defaults to ./main, grammar_file to grammar, without .dat)
+
+MAIN=${1:-./main}
+GRAMMAR=${2:-grammar}
+STACK_KB=512
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+if [ ! -x "$MAIN" ]; then
+    echo "stress: $MAIN not found, build it with g++ -std=c++17 -O2 -pthread main.cpp -o main"
+    exit 1
+fi
+
+# 20000 statements in one function: a long right-recursive <block_item_list>
+awk 'BEGIN {
+    print "int main() {"; print "  int x;"
+    for(i = 0; i < 20000; i++) print "  x = x + 1;"
+    print "  return 0;"; print "}"
+}' > "$DIR/statements.vc"
+
+# 5000 nested parentheses, a 10000-term sum and 3000 nested blocks
+awk 'BEGIN {
+    print "int main() {"; print "  int x;"
+    s = "  x = "; for(i = 0; i < 5000; i++) s = s "("; s = s "1"
+    for(i = 0; i < 5000; i++) s = s ")"; print s ";"
+    s = "  x = x"; for(i = 1; i < 10000; i++) s = s " + x"; print s ";"
+    s = "  "; for(i = 0; i < 3000; i++) s = s "{"; s = s " x = 1; "
+    for(i = 0; i < 3000; i++) s = s "}"; print s
+    print "  return 0;"; print "}"
+}' > "$DIR/nested.vc"
+
+# 300 nested parentheses for the full view, whose prefixes grow with the depth
+awk 'BEGIN {
+    print "int main() {"; print "  int x;"
+    s = "  x = "; for(i = 0; i < 300; i++) s = s "("; s = s "1"
+    for(i = 0; i < 300; i++) s = s ")"; print s ";"
+    print "  return 0;"; print "}"
+}' > "$DIR/full.vc"
+
+fail=0
+# run <name> <formats> <extra args...>: reference under the caller's stack,
+# then the same parse under STACK_KB; both must succeed with equal outputs
+run() {
+    name=$1; formats=$2; shift 2
+    "$MAIN" "$DIR/$name" "$DIR/ref" "$GRAMMAR" --formats="$formats" > "$DIR/ref.out" 2>&1
+    ref_rc=$?
+    (ulimit -s $STACK_KB; "$MAIN" "$DIR/$name" "$DIR/small" "$GRAMMAR" --formats="$formats" "$@") > "$DIR/small.out" 2>&1
+    small_rc=$?
+    if [ $ref_rc -ne 0 ] || [ $small_rc -ne 0 ] || [ -s "$DIR/ref.out" ]; then
+        echo "FAIL $name $*: exit $ref_rc / $small_rc"
+        cat "$DIR/ref.out" "$DIR/small.out" | head -5
+        fail=1
+        return
+    fi
+    for suffix in .vcps _full.vcps _bracket.vcps; do
+        if [ -f "$DIR/ref$suffix" ] && ! cmp -s "$DIR/ref$suffix" "$DIR/small$suffix"; then
+            echo "FAIL $name $*: small$suffix differs"
+            fail=1
+        fi
+    done
+    rm -f "$DIR"/ref* "$DIR"/small*
+    echo "ok $name $*"
+}
+
+run statements reduced,bracket
+run statements reduced,bracket --stream
+run nested reduced,bracket
+run nested reduced,bracket --stream
+run nested reduced,bracket --split --jobs=2
+run full full
+
+[ $fail -eq 0 ] && echo "stress: all deep inputs parsed with a $STACK_KB KB stack"
+exit $fail
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace xd {
+    // Work-stealing pool for a batch of independent tasks. Every worker starts
+    // with a contiguous block of task numbers in its own queue, takes from the
+    // front of it and, once it runs dry, steals from the back of the others.
+    class thread_pool {
+        struct task_queue {
+            mutex lock;
+            deque<size_t> tasks;
+        };
+
+        size_t worker_count;
+
+        static bool pop_front(task_queue& queue, size_t& task) {
+            lock_guard<mutex> guard(queue.lock);
+            if(queue.tasks.empty()) {
+                return false;
+            }
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+
+        static bool pop_back(task_queue& queue, size_t& task) {
+            lock_guard<mutex> guard(queue.lock);
+            if(queue.tasks.empty()) {
+                return false;
+            }
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+
+        public:
+
+        // 0 workers means one per hardware thread
+        explicit thread_pool(size_t workers = 0) {
+            worker_count = workers != 0 ? workers : max<size_t>(1, thread::hardware_concurrency());
+        }
+
+        size_t get_worker_count() const {return worker_count;}
+
+        // Calls task(worker_no, task_no) once for every task_no below count and
+        // returns when all are done. Calls on one worker never overlap, so
+        // per-worker state indexed by worker_no needs no locking.
+        template<typename task_t>
+        void run(size_t count, task_t task) {
+            size_t workers = min(worker_count, max<size_t>(count, 1));
+            vector<task_queue> queues(workers);
+            for(size_t no = 0; no < count; no++) {
+                queues[no * workers / count].tasks.push_back(no);
+            }
+
+            auto work = [&](size_t worker_no) {
+                size_t task_no;
+                for(;;) {
+                    if(pop_front(queues[worker_no], task_no)) {
+                        task(worker_no, task_no);
+                        continue;
+                    }
+                    // no task is ever added, so one empty sweep means done
+                    bool stolen = false;
+                    for(size_t offset = 1; offset < workers && !stolen; offset++) {
+                        stolen = pop_back(queues[(worker_no + offset) % workers], task_no);
+                    }
+                    if(!stolen) {
+                        return;
+                    }
+                    task(worker_no, task_no);
+                }
+            };
+
+            vector<thread> threads;
+            for(size_t worker_no = 1; worker_no < workers; worker_no++) {
+                threads.emplace_back(work, worker_no);
+            }
+            work(0);
+            for(auto& worker : threads) {
+                worker.join();
+            }
+        }
+    };
+}
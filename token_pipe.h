@@ -0,0 +1,68 @@
+#pragma once
+
+#include "lexer.h"
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+namespace xd {
+    // Bounded ring of token blocks between one producer thread (the lexer)
+    // and one consumer (the parser). Blocks change hands by swapping
+    // vectors, so tokens are never copied and memory stays at
+    // BLOCK_COUNT + 2 blocks whatever the input size. push() waits while
+    // the ring is full, pull() while it is empty.
+    class token_pipe {
+        vector<vector<token_span>> blocks;
+        size_t written{};
+        size_t read{};
+        bool closed{};
+        mutex lock_;
+        condition_variable has_block;
+        condition_variable has_room;
+
+        public:
+
+        static constexpr size_t BLOCK_TOKENS = 4096;
+        static constexpr size_t BLOCK_COUNT = 4;
+
+        token_pipe() : blocks(BLOCK_COUNT) {}
+
+        token_pipe(const token_pipe&) = delete;
+        token_pipe& operator=(const token_pipe&) = delete;
+
+        // producer: hands over a non-empty block, tokens comes back empty
+        void push(vector<token_span>& tokens) {
+            unique_lock<mutex> lock(lock_);
+            has_room.wait(lock, [this] {return written - read < blocks.size();});
+            swap(blocks[written % blocks.size()], tokens);
+            written++;
+            has_block.notify_one();
+            lock.unlock();
+            tokens.clear();
+        }
+
+        // producer: no more blocks follow
+        void close() {
+            lock_guard<mutex> lock(lock_);
+            closed = true;
+            has_block.notify_one();
+        }
+
+        // consumer: replaces tokens by the next block, leaves it empty once
+        // the producer has closed the pipe and every block is read
+        void pull(vector<token_span>& tokens) {
+            unique_lock<mutex> lock(lock_);
+            has_block.wait(lock, [this] {return read < written || closed;});
+            tokens.clear();
+            if(read == written) {
+                return;
+            }
+            swap(blocks[read % blocks.size()], tokens);
+            read++;
+            has_room.notify_one();
+        }
+    };
+}
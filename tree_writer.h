@@ -0,0 +1,100 @@
+#pragma once
+
+#include "buffered_writer.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+namespace xd {
+    // Draws a tree in the .vcps format from nodes fed in pre-order: root()
+    // once, kid() for every other node, close() after the last kid of each
+    // node that has kids.
+    class vcps_writer {
+        struct frame {
+            size_t n_kids;
+            size_t next_kid;
+            size_t prefix_length;
+        };
+
+        buffered_writer out;
+        // prefixes of all open levels, frames remember where theirs ends
+        string prefix;
+        vector<frame> frames;
+
+        void open(size_t n_kids) {
+            if(n_kids == 0) return;
+            out << prefix;
+            out << (n_kids > 1 ? "├── " : "");
+            frames.push_back({n_kids, 0, prefix.size()});
+        }
+
+        public:
+
+        explicit vcps_writer(ostream& os) : out(os) {}
+
+        void root(string_view value, size_t n_kids) {
+            out << value << '\n';
+            open(n_kids);
+        }
+
+        // https://stackoverflow.com/questions/59508678/c-print-tree-not-necessarily-binary-in-a-pretty-way-to-stdout
+        void kid(string_view value, size_t n_kids) {
+            frame& parent = frames.back();
+            size_t i = parent.next_kid++;
+            size_t n = parent.n_kids;
+            prefix.resize(parent.prefix_length);
+            if (i < n - 1) {
+                if (i > 0) { // added fix
+                out << prefix << "├── "; // added fix
+                }
+                bool printStrand = n > 1 && n_kids != 0;
+                out << value << '\n';
+                prefix += (printStrand ? "│\t" : "\t");
+            } else {
+                out << (n > 1 ? string_view(prefix) : string_view()) << "└── ";
+                out << value << '\n';
+                prefix += "\t";
+            }
+            open(n_kids);
+        }
+
+        void close() {
+            frames.pop_back();
+        }
+
+        void finish() {
+            out << '\n';
+        }
+    };
+
+    // Writes the bracket form: "( " and ") " around every non-terminal,
+    // terminals in between with parentheses escaped.
+    class bracket_writer {
+        buffered_writer out;
+
+        public:
+
+        explicit bracket_writer(ostream& os) : out(os) {}
+
+        void open() {
+            out << "( ";
+        }
+
+        void terminal(string_view value) {
+            if(value == "(") {
+                out << "\\( ";
+            } else if(value == ")") {
+                out << "\\) ";
+            } else {
+                out << value << ' ';
+            }
+        }
+
+        void close() {
+            out << ") ";
+        }
+    };
+}
@@ -3,244 +3,221 @@
 #include "grammar.h"
 #include <algorithm>
 #include <unordered_map>
-#include <set>
-#include <functional>
+#include <cstdint>
 using namespace std;
 namespace xd {
 
-    const string STRING_ENDMARKER = "__$__";
-
-    vrule get_rules_with_parent(const vprod& grammar, const string& parent) {
-        for(const auto& prod : grammar) {
-            if(prod.get_parent() == parent) {
-                return prod.get_rules();
-            }
+    // 64-bit FNV-1a, used to fingerprint grammar sources and binary payloads
+    uint64_t hash_bytes(const char* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+        for(size_t no = 0; no < size; no++) {
+            hash ^= static_cast<unsigned char>(data[no]);
+            hash *= 1099511628211ULL;
         }
-        return vrule{};
+        return hash;
     }
 
-    vs get_all_non_terminals(const vprod& grammar) {
-        vs non_terminals;
-        for(const auto& prod : grammar) {
-            non_terminals.push_back(prod.get_parent());
-        }
-        return non_terminals;
-    }
+    // dynamic bitset over symbol ids
+    class symbol_set {
+        vector<uint64_t> words;
 
-    bool has_parent(const vprod& grammar, string parent) {
-        return std::any_of(grammar.begin(), grammar.end(), [&](const production& prod) {
-            return prod.get_parent() == parent;
-        });
-    }
+        public:
+        symbol_set() = default;
+        explicit symbol_set(size_t size) : words((size + 63) / 64, 0) {}
 
-    vs get_all_terminals(const vprod& grammar) {
-        vs terminals;
-        for(const auto& prod : grammar) {
-            for(const auto& rule : prod.get_rules()) {
-                for(const auto& entity: rule.get_entities()) {
-                    if(!has_parent(grammar, entity) && entity != EPSILON) {
-                        terminals.push_back(entity);
-                    }
-                }
-            }
+        bool test(symbol_id id) const {
+            return (words[id >> 6U] >> (id & 63U)) & 1U;
         }
-        terminals.erase(std::unique(terminals.begin(), terminals.end()), terminals.end());
-        return terminals;
-    }
-
-    using nullables_table = unordered_map<string, bool>;
 
-    nullables_table calc_nullables(const vprod& grammar) {
-        nullables_table nullables;
-        auto terminals = get_all_terminals(grammar);
-        for(const auto& terminal : terminals) {
-            nullables[terminal] = false;
+        void set(symbol_id id) {
+            words[id >> 6U] |= uint64_t(1) << (id & 63U);
         }
 
-        nullables[EPSILON] = true;
+        void reset(symbol_id id) {
+            words[id >> 6U] &= ~(uint64_t(1) << (id & 63U));
+        }
 
-        function<bool(const string&, vs&)> calc_recursive = [&](const string& key, vs& path) {
-            if(find(path.begin(), path.end(), key) != path.end()) {
-                return false;
+        // union with other, returns whether any bit was added
+        bool merge(const symbol_set& other) {
+            uint64_t added = 0;
+            for(size_t no = 0; no < words.size(); no++) {
+                added |= other.words[no] & ~words[no];
+                words[no] |= other.words[no];
             }
+            return added != 0;
+        }
 
-            if(nullables.find(key) != nullables.end()) {
-                return nullables[key];
+        template<typename F>
+        void for_each(F f) const {
+            for(size_t no = 0; no < words.size(); no++) {
+                for(uint64_t word = words[no]; word != 0; word &= word - 1) {
+                    f(static_cast<symbol_id>(no * 64 + __builtin_ctzll(word)));
+                }
             }
+        }
 
-            path.push_back(key);
-            
-            for(const auto& rule: get_rules_with_parent(grammar, key)) {
-                bool perma_stop = false;
-                for(auto& entity : rule.get_entities()) {
-                    if(!calc_recursive(entity, path)) {
-                        perma_stop = true;
-                        break;
-                    }
-                }
+        vsym to_vector() const {
+            vsym ids;
+            for_each([&](symbol_id id) {ids.push_back(id);});
+            return ids;
+        }
+    };
+
+    // one symbol in the body of one rule
+    struct occurrence {
+        size_t prod_no;
+        size_t rule_no;
+        size_t entity_no;
+    };
+
+    // Propagates sets[from] into sets[to] along the edges until nothing changes,
+    // revisiting a symbol only when its own set has grown.
+    void propagate(vector<symbol_set>& sets, const vector<vsym>& edges) {
+        vsym worklist;
+        vector<bool> queued(sets.size(), false);
+        for(symbol_id id = 0; id < sets.size(); id++) {
+            if(!edges[id].empty()) {
+                worklist.push_back(id);
+                queued[id] = true;
+            }
+        }
 
-                if(!perma_stop) {
-                    nullables[key] = true;
-                    path.pop_back();
-                    return true;
+        while(!worklist.empty()) {
+            symbol_id from = worklist.back();
+            worklist.pop_back();
+            queued[from] = false;
+            for(symbol_id to : edges[from]) {
+                if(sets[to].merge(sets[from]) && !queued[to] && !edges[to].empty()) {
+                    worklist.push_back(to);
+                    queued[to] = true;
                 }
             }
-
-            nullables[key] = false;
-            path.pop_back();
-            return false;
-        };
-
-        for(const auto& prod : grammar) {
-            vs path;
-            calc_recursive(prod.get_parent(), path);
         }
-
-        return nullables;
     }
 
-    using symbols_table = unordered_map<string, vs>;
-
-    symbols_table calc_firsts(const vprod& grammar, nullables_table nullables) {
-        symbols_table firsts;
-        auto terminals = get_all_terminals(grammar);
-        for(const auto& terminal : terminals) {
-            firsts[terminal] = {terminal};
-        }
-
-        firsts[EPSILON] = {EPSILON};
-
-        bool finish = false;
+    using nullables_table = symbol_set;
+
+    nullables_table calc_nullables(const vprod& grammar, const symbol_table& symbols) {
+        nullables_table nullables(symbols.size());
+        nullables.set(symbols.get_epsilon());
+
+        // remaining[prod_no][rule_no]: body symbols not yet known to be nullable
+        vector<vector<size_t>> remaining(grammar.size());
+        vector<vector<occurrence>> occurrences(symbols.size());
+        vsym worklist;
+
+        for(size_t prod_no = 0; prod_no < grammar.size(); prod_no++) {
+            const auto& rules = grammar[prod_no].get_rules();
+            remaining[prod_no].resize(rules.size());
+            for(size_t rule_no = 0; rule_no < rules.size(); rule_no++) {
+                const auto& entities = rules[rule_no].get_entities();
+                for(size_t entity_no = 0; entity_no < entities.size(); entity_no++) {
+                    if(entities[entity_no] != symbols.get_epsilon()) {
+                        remaining[prod_no][rule_no]++;
+                        occurrences[entities[entity_no]].push_back({prod_no, rule_no, entity_no});
+                    }
+                }
 
-        function<vs(const string&, vs&)> calc_recursive = [&](const string& key, vs& path) {
-            if(!has_parent(grammar, key)) {
-                return firsts[key];
+                symbol_id parent = grammar[prod_no].get_parent();
+                if(remaining[prod_no][rule_no] == 0 && !nullables.test(parent)) {
+                    nullables.set(parent);
+                    worklist.push_back(parent);
+                }
             }
+        }
 
-            if(find(path.begin(), path.end(), key) != path.end()) {
-                return firsts[key];
+        while(!worklist.empty()) {
+            symbol_id id = worklist.back();
+            worklist.pop_back();
+            for(const auto& occ : occurrences[id]) {
+                symbol_id parent = grammar[occ.prod_no].get_parent();
+                if(--remaining[occ.prod_no][occ.rule_no] == 0 && !nullables.test(parent)) {
+                    nullables.set(parent);
+                    worklist.push_back(parent);
+                }
             }
+        }
 
-            if(firsts.find(key) != firsts.end()) {
-                return firsts[key];
-            }
+        return nullables;
+    }
 
-            path.push_back(key);
+    // sets indexed by symbol id, only filled for non-terminals
+    using symbols_table = vector<symbol_set>;
 
-            if(firsts.find(key) == firsts.end()) {
-                firsts[key] = {};
-                finish = false;
-            }
+    symbols_table calc_firsts(const vprod& grammar, const symbol_table& symbols, const nullables_table& nullables) {
+        symbols_table firsts(symbols.size(), symbol_set(symbols.size()));
+        // edges[y] lists every x with FIRST(x) ⊇ FIRST(y)
+        vector<vsym> edges(symbols.size());
 
-            for(const auto& rule: get_rules_with_parent(grammar, key)) {
-                bool perma_stop = false;
-                for(auto& entity : rule.get_entities()) {
-                    vs first = calc_recursive(entity, path);
-                    for(const auto& der : first) {
-                        if(der != EPSILON && find(firsts[key].begin(), firsts[key].end(), der) == firsts[key].end()) {
-                            firsts[key].push_back(der);
-                            finish = false;
-                        }
+        for(const auto& prod : grammar) {
+            symbol_id parent = prod.get_parent();
+            for(const auto& rule : prod.get_rules()) {
+                for(symbol_id entity : rule.get_entities()) {
+                    if(symbols.is_terminal(entity)) {
+                        firsts[parent].set(entity);
+                    } else if(symbols.is_non_terminal(entity) && entity != parent) {
+                        edges[entity].push_back(parent);
                     }
 
-                    if(!nullables.at(entity)) {
-                        perma_stop = true;
+                    if(!nullables.test(entity)) {
                         break;
                     }
                 }
-
-                if(!perma_stop) {
-                    if(find(firsts[key].begin(), firsts[key].end(), EPSILON) == firsts[key].end()) {
-                        firsts[key].push_back(EPSILON);
-                        finish = false;
-                    }
-                }
             }
+        }
 
-            path.pop_back();
-            return firsts[key];
-        };
+        propagate(firsts, edges);
 
-        while(!finish) {
-            finish = true;
-            for(const auto& prod : grammar) {
-                vs path;
-                calc_recursive(prod.get_parent(), path);
+        for(const auto& prod : grammar) {
+            if(nullables.test(prod.get_parent())) {
+                firsts[prod.get_parent()].set(symbols.get_epsilon());
             }
         }
 
-        for(const auto& terminal : terminals) {
-            firsts.erase(terminal);
-        }
-
-        firsts.erase(EPSILON);
-
         return firsts;
     }
 
-    symbols_table calc_follows(const vprod& grammar, const nullables_table& nullables, const symbols_table& firsts, const string& start_symbol) {
-        symbols_table follows;
-        bool finish = false;
-
-        auto aug_firsts = firsts;
-        auto terminals = get_all_terminals(grammar);
-        for(const auto& terminal : terminals) {
-            aug_firsts[terminal] = {terminal};
-        }
+    symbols_table calc_follows(const vprod& grammar, const symbol_table& symbols, const nullables_table& nullables, const symbols_table& firsts, symbol_id start_symbol) {
+        const symbol_id epsilon = symbols.get_epsilon();
+        symbols_table follows(symbols.size(), symbol_set(symbols.size()));
+        // edges[x] lists every y with FOLLOW(y) ⊇ FOLLOW(x)
+        vector<vsym> edges(symbols.size());
 
-        aug_firsts[EPSILON] = {EPSILON};
+        follows[start_symbol].set(symbols.get_endmarker());
 
         for(const auto& prod : grammar) {
-            if(prod.get_parent() == start_symbol) {
-                follows[prod.get_parent()] = {STRING_ENDMARKER};
-            } else {
-                follows[prod.get_parent()] = {};
-            }
-        }
+            symbol_id parent = prod.get_parent();
+            for(const auto& rule : prod.get_rules()) {
+                const auto& entities = rule.get_entities();
+                for(size_t entity_no = 0; entity_no < entities.size(); entity_no++) {
+                    symbol_id curr = entities[entity_no];
+                    if(!symbols.is_non_terminal(curr)) {
+                        continue;
+                    }
 
-        function<void(const string&)> calc_recursive = [&](const string& key) {
-            for(const auto& rule : get_rules_with_parent(grammar, key)) {
-                for(auto entity_it = rule.get_entities().begin(); entity_it != rule.get_entities().end(); entity_it++) {
-                    auto curr = *entity_it;
-                    if(has_parent(grammar, curr)) {
-                        auto next_it = entity_it + 1;
-                        for(; next_it != rule.get_entities().end(); next_it++) {
-                            for(const auto& der : aug_firsts[*next_it]) {
-                                if(der != EPSILON && find(follows[curr].begin(), follows[curr].end(), der) == follows[curr].end()) {
-                                    follows[curr].push_back(der);
-                                    finish = false;
-                                }   
-                            }
-
-                            if(!nullables.at(*next_it)) {
-                                break;
-                            }
+                    size_t next_no = entity_no + 1;
+                    for(; next_no < entities.size(); next_no++) {
+                        symbol_id next = entities[next_no];
+                        if(symbols.is_terminal(next)) {
+                            follows[curr].set(next);
+                        } else if(symbols.is_non_terminal(next)) {
+                            follows[curr].merge(firsts[next]);
+                            follows[curr].reset(epsilon);
                         }
 
-                        if(next_it == rule.get_entities().end()) {
-                            for(const auto& der : follows[key]) {
-                                if(find(follows[curr].begin(), follows[curr].end(), der) == follows[curr].end()) {
-                                    follows[curr].push_back(der);
-                                    finish = false;
-                                }   
-                            }
+                        if(!nullables.test(next)) {
+                            break;
                         }
                     }
-                }
-            }  
-        };
-
-        while(!finish) {
-            finish = true;
-            calc_recursive(start_symbol);
 
-            for(const auto& prod : grammar) {
-                if(prod.get_parent() != start_symbol) {
-                    calc_recursive(prod.get_parent());
+                    if(next_no == entities.size() && curr != parent) {
+                        edges[parent].push_back(curr);
+                    }
                 }
             }
         }
 
+        propagate(follows, edges);
+
         return follows;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,516 @@
+// Generated by ll1_codegen from grammar.dat, do not edit.
+#pragma once
+
+#include "lexer.h"
+#include "parsing_tree.h"
+
+using namespace std;
+
+namespace xd {
+    // LL(1) parser for grammar.dat with the parsing table folded into
+    // select_rule(); builds the same trees as parser with that grammar.
+    class vc_parser {
+        public:
+
+        static constexpr uint64_t GRAMMAR_HASH = 0x39179877e4ced6c6ULL;
+        static constexpr symbol_id TERMINAL_COUNT = 40;
+        static constexpr symbol_id NON_TERMINAL_COUNT = 56;
+        static constexpr symbol_id ENDMARKER = 39;
+        static constexpr symbol_id EPSILON_SYMBOL = 96;
+        static constexpr symbol_id START_SYMBOL = 65; // <program>
+
+        private:
+
+        // name of every symbol id up to EPSILON_SYMBOL
+        static constexpr string_view NAMES[] = {
+            "(", ")", "{", "}", "*", "+", "-", "/",
+            "%", ",", "<", ">", "<=", ">=", "=", "==",
+            "!", "!=", ";", "[", "]", "&&", "||", "identifier",
+            "integer_constant", "float_constant", "boolean_constant", "string_constant", "for", "while", "break", "continue",
+            "return", "else", "float", "if", "int", "void", "boolean", "__$__",
+            "<primary_expression>", "<constant>", "<unary_operator>", "<unary_expression>", "<type_specifier>", "<multiplicative_expression>", "<additive_expression>", "<relational_expression>",
+            "<equality_expression>", "<assignment_expression>", "<expression>", "<declarator_tail>", "<declaration>", "<init_declarator_list>", "<init_declarator>", "<initializer>",
+            "<declarator>", "<direct_declarator>", "<declarator_int>", "<statement>", "<compound_statement>", "<block_item_list>", "<block_item>", "<expression_statement>",
+            "<selection_statement>", "<program>", "<primary_expression_tail>", "<for_statement>", "<while_statement>", "<expression_question>", "<break_statement>", "<continue_statement>",
+            "<return_statement>", "<argument_list>", "<argument>", "<parameter_list>", "<parameter>", "<argument_list_temp>", "<assignment_expression_temp>", "<multiplicative_expression_temp>",
+            "<init_declarator_list_temp>", "<relational_expression_temp>", "<equality_expression_temp>", "<init_declarator_temp>", "<parameter_list_temp>", "<additive_expression_temp>", "<selection_statement_temp>", "<block_item_list_temp>",
+            "<parameter_list_question>", "<argument_list_question>", "<func_decl>", "<program_tail>", "<conditional_and_expression>", "<conditional_and_expression_temp>", "<conditional_or_expression>", "<conditional_or_expression_temp>",
+            "EPSILON",
+        };
+
+        // bodies of all rules, rule r is ENTITIES[RULE_BEGIN[r], RULE_BEGIN[r + 1])
+        static constexpr symbol_id ENTITIES[] = {
+            90, 91, 90, 91, 96, 44, 23, 0, 88, 1, 60, 44, 56, 9, 76, 84,
+            96, 76, 84, 84, 75, 96, 50, 9, 74, 77, 96, 74, 77, 77, 73, 96,
+            44, 53, 18, 9, 54, 80, 96, 54, 80, 80, 56, 83, 96, 14, 55, 37,
+            36, 34, 38, 19, 58, 20, 96, 24, 96, 57, 51, 23, 0, 56, 1, 50,
+            19, 50, 20, 0, 89, 1, 96, 23, 66, 41, 0, 50, 1, 24, 25, 26,
+            27, 5, 6, 16, 40, 42, 40, 4, 43, 79, 7, 43, 79, 96, 43, 79,
+            5, 45, 85, 6, 45, 85, 96, 45, 85, 10, 46, 81, 11, 46, 81, 12,
+            46, 81, 13, 46, 81, 96, 46, 81, 15, 47, 82, 17, 47, 82, 96, 47,
+            82, 21, 48, 93, 96, 48, 93, 22, 92, 95, 96, 92, 95, 14, 94, 78,
+            96, 94, 78, 49, 50, 96, 60, 63, 64, 67, 68, 70, 71, 72, 2, 61,
+            3, 52, 59, 62, 87, 96, 96, 61, 50, 18, 18, 32, 69, 18, 31, 18,
+            30, 18, 35, 0, 50, 1, 60, 86, 96, 33, 59, 28, 0, 69, 18, 69,
+            18, 69, 1, 59, 29, 0, 50, 1, 59,
+        };
+
+        static constexpr uint32_t RULE_BEGIN[] = {
+            0, 2, 4, 5, 11, 13, 16, 17, 19, 20, 21, 22, 23, 26, 27, 29,
+            30, 31, 32, 35, 38, 39, 41, 42, 44, 45, 47, 48, 49, 50, 51, 54,
+            55, 56, 57, 59, 60, 63, 64, 67, 70, 71, 73, 74, 77, 78, 79, 80,
+            81, 82, 83, 84, 85, 87, 90, 93, 94, 96, 99, 102, 103, 105, 108, 111,
+            114, 117, 118, 120, 123, 126, 127, 129, 132, 133, 135, 138, 139, 141, 144, 145,
+            147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157, 158, 161, 162, 163, 165,
+            166, 167, 168, 170, 171, 174, 176, 178, 184, 185, 187, 196, 201,
+        };
+
+        static constexpr uint32_t NO_RULE = ~0U;
+
+        // rule that expands non_terminal on token, NO_RULE for an error
+        static uint32_t select_rule(symbol_id non_terminal, symbol_id token) {
+            switch(non_terminal) {
+                case 40: // <primary_expression>
+                    switch(token) {
+                        case 23: return 41; // <primary_expression> : identifier <primary_expression_tail>
+                        case 24: case 25: case 26: case 27: return 42; // <primary_expression> : <constant>
+                        case 0: return 43; // <primary_expression> : ( <expression> )
+                    }
+                    break;
+                case 41: // <constant>
+                    switch(token) {
+                        case 24: return 44; // <constant> : integer_constant
+                        case 25: return 45; // <constant> : float_constant
+                        case 26: return 46; // <constant> : boolean_constant
+                        case 27: return 47; // <constant> : string_constant
+                    }
+                    break;
+                case 42: // <unary_operator>
+                    switch(token) {
+                        case 5: return 48; // <unary_operator> : +
+                        case 6: return 49; // <unary_operator> : -
+                        case 16: return 50; // <unary_operator> : !
+                    }
+                    break;
+                case 43: // <unary_expression>
+                    switch(token) {
+                        case 0: case 23: case 24: case 25: case 26: case 27: return 51; // <unary_expression> : <primary_expression>
+                        case 5: case 6: case 16: return 52; // <unary_expression> : <unary_operator> <primary_expression>
+                    }
+                    break;
+                case 44: // <type_specifier>
+                    switch(token) {
+                        case 37: return 26; // <type_specifier> : void
+                        case 36: return 27; // <type_specifier> : int
+                        case 34: return 28; // <type_specifier> : float
+                        case 38: return 29; // <type_specifier> : boolean
+                    }
+                    break;
+                case 45: // <multiplicative_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 56; // <multiplicative_expression> : <unary_expression> <multiplicative_expression_temp>
+                    }
+                    break;
+                case 46: // <additive_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 60; // <additive_expression> : <multiplicative_expression> <additive_expression_temp>
+                    }
+                    break;
+                case 47: // <relational_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 66; // <relational_expression> : <additive_expression> <relational_expression_temp>
+                    }
+                    break;
+                case 48: // <equality_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 70; // <equality_expression> : <relational_expression> <equality_expression_temp>
+                    }
+                    break;
+                case 49: // <assignment_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 79; // <assignment_expression> : <conditional_or_expression> <assignment_expression_temp>
+                    }
+                    break;
+                case 50: // <expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 80; // <expression> : <assignment_expression>
+                    }
+                    break;
+                case 51: // <declarator_tail>
+                    switch(token) {
+                        case 19: return 30; // <declarator_tail> : [ <declarator_int> ]
+                        case 1: case 9: case 14: case 18: return 31; // <declarator_tail> : EPSILON
+                    }
+                    break;
+                case 52: // <declaration>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 18; // <declaration> : <type_specifier> <init_declarator_list> ;
+                    }
+                    break;
+                case 53: // <init_declarator_list>
+                    switch(token) {
+                        case 0: case 23: return 21; // <init_declarator_list> : <init_declarator> <init_declarator_list_temp>
+                        case 9: return 22; // <init_declarator_list> : <init_declarator_list_temp>
+                    }
+                    break;
+                case 54: // <init_declarator>
+                    switch(token) {
+                        case 0: case 23: return 23; // <init_declarator> : <declarator> <init_declarator_temp>
+                    }
+                    break;
+                case 55: // <initializer>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 37; // <initializer> : <expression>
+                    }
+                    break;
+                case 56: // <declarator>
+                    switch(token) {
+                        case 0: case 23: return 34; // <declarator> : <direct_declarator> <declarator_tail>
+                    }
+                    break;
+                case 57: // <direct_declarator>
+                    switch(token) {
+                        case 23: return 35; // <direct_declarator> : identifier
+                        case 0: return 36; // <direct_declarator> : ( <declarator> )
+                    }
+                    break;
+                case 58: // <declarator_int>
+                    switch(token) {
+                        case 24: return 32; // <declarator_int> : integer_constant
+                        case 20: return 33; // <declarator_int> : EPSILON
+                    }
+                    break;
+                case 59: // <statement>
+                    switch(token) {
+                        case 2: return 83; // <statement> : <compound_statement>
+                        case 0: case 5: case 6: case 16: case 18: case 23: case 24: case 25: case 26: case 27: return 84; // <statement> : <expression_statement>
+                        case 35: return 85; // <statement> : <selection_statement>
+                        case 28: return 86; // <statement> : <for_statement>
+                        case 29: return 87; // <statement> : <while_statement>
+                        case 30: return 88; // <statement> : <break_statement>
+                        case 31: return 89; // <statement> : <continue_statement>
+                        case 32: return 90; // <statement> : <return_statement>
+                    }
+                    break;
+                case 60: // <compound_statement>
+                    switch(token) {
+                        case 2: return 91; // <compound_statement> : { <block_item_list> }
+                    }
+                    break;
+                case 61: // <block_item_list>
+                    switch(token) {
+                        case 0: case 2: case 5: case 6: case 16: case 18: case 23: case 24: case 25: case 26: case 27: case 28: case 29: case 30: case 31: case 32: case 34: case 35: case 36: case 37: case 38: return 94; // <block_item_list> : <block_item> <block_item_list_temp>
+                        case 3: return 95; // <block_item_list> : EPSILON
+                    }
+                    break;
+                case 62: // <block_item>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 92; // <block_item> : <declaration>
+                        case 0: case 2: case 5: case 6: case 16: case 18: case 23: case 24: case 25: case 26: case 27: case 28: case 29: case 30: case 31: case 32: case 35: return 93; // <block_item> : <statement>
+                    }
+                    break;
+                case 63: // <expression_statement>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 98; // <expression_statement> : <expression> ;
+                        case 18: return 99; // <expression_statement> : ;
+                    }
+                    break;
+                case 64: // <selection_statement>
+                    switch(token) {
+                        case 35: return 103; // <selection_statement> : if ( <expression> ) <compound_statement> <selection_statement_temp>
+                    }
+                    break;
+                case 65: // <program>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 0; // <program> : <func_decl> <program_tail>
+                    }
+                    break;
+                case 66: // <primary_expression_tail>
+                    switch(token) {
+                        case 19: return 38; // <primary_expression_tail> : [ <expression> ]
+                        case 0: return 39; // <primary_expression_tail> : ( <argument_list_question> )
+                        case 1: case 4: case 5: case 6: case 7: case 9: case 10: case 11: case 12: case 13: case 14: case 15: case 17: case 18: case 20: case 21: case 22: return 40; // <primary_expression_tail> : EPSILON
+                    }
+                    break;
+                case 67: // <for_statement>
+                    switch(token) {
+                        case 28: return 106; // <for_statement> : for ( <expression_question> ; <expression_question> ; <expression_question> ) <statement>
+                    }
+                    break;
+                case 68: // <while_statement>
+                    switch(token) {
+                        case 29: return 107; // <while_statement> : while ( <expression> ) <statement>
+                    }
+                    break;
+                case 69: // <expression_question>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 81; // <expression_question> : <expression>
+                        case 1: case 18: return 82; // <expression_question> : EPSILON
+                    }
+                    break;
+                case 70: // <break_statement>
+                    switch(token) {
+                        case 30: return 102; // <break_statement> : break ;
+                    }
+                    break;
+                case 71: // <continue_statement>
+                    switch(token) {
+                        case 31: return 101; // <continue_statement> : continue ;
+                    }
+                    break;
+                case 72: // <return_statement>
+                    switch(token) {
+                        case 32: return 100; // <return_statement> : return <expression_question> ;
+                    }
+                    break;
+                case 73: // <argument_list>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 14; // <argument_list> : <argument> <argument_list_temp>
+                        case 9: return 15; // <argument_list> : <argument_list_temp>
+                    }
+                    break;
+                case 74: // <argument>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 11; // <argument> : <expression>
+                    }
+                    break;
+                case 75: // <parameter_list>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 7; // <parameter_list> : <parameter> <parameter_list_temp>
+                        case 9: return 8; // <parameter_list> : <parameter_list_temp>
+                    }
+                    break;
+                case 76: // <parameter>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 4; // <parameter> : <type_specifier> <declarator>
+                    }
+                    break;
+                case 77: // <argument_list_temp>
+                    switch(token) {
+                        case 9: return 12; // <argument_list_temp> : , <argument> <argument_list_temp>
+                        case 1: return 13; // <argument_list_temp> : EPSILON
+                    }
+                    break;
+                case 78: // <assignment_expression_temp>
+                    switch(token) {
+                        case 14: return 77; // <assignment_expression_temp> : = <conditional_or_expression> <assignment_expression_temp>
+                        case 1: case 9: case 18: case 20: return 78; // <assignment_expression_temp> : EPSILON
+                    }
+                    break;
+                case 79: // <multiplicative_expression_temp>
+                    switch(token) {
+                        case 4: return 53; // <multiplicative_expression_temp> : * <unary_expression> <multiplicative_expression_temp>
+                        case 7: return 54; // <multiplicative_expression_temp> : / <unary_expression> <multiplicative_expression_temp>
+                        case 1: case 5: case 6: case 9: case 10: case 11: case 12: case 13: case 14: case 15: case 17: case 18: case 20: case 21: case 22: return 55; // <multiplicative_expression_temp> : EPSILON
+                    }
+                    break;
+                case 80: // <init_declarator_list_temp>
+                    switch(token) {
+                        case 9: return 19; // <init_declarator_list_temp> : , <init_declarator> <init_declarator_list_temp>
+                        case 18: return 20; // <init_declarator_list_temp> : EPSILON
+                    }
+                    break;
+                case 81: // <relational_expression_temp>
+                    switch(token) {
+                        case 10: return 61; // <relational_expression_temp> : < <additive_expression> <relational_expression_temp>
+                        case 11: return 62; // <relational_expression_temp> : > <additive_expression> <relational_expression_temp>
+                        case 12: return 63; // <relational_expression_temp> : <= <additive_expression> <relational_expression_temp>
+                        case 13: return 64; // <relational_expression_temp> : >= <additive_expression> <relational_expression_temp>
+                        case 1: case 9: case 14: case 15: case 17: case 18: case 20: case 21: case 22: return 65; // <relational_expression_temp> : EPSILON
+                    }
+                    break;
+                case 82: // <equality_expression_temp>
+                    switch(token) {
+                        case 15: return 67; // <equality_expression_temp> : == <relational_expression> <equality_expression_temp>
+                        case 17: return 68; // <equality_expression_temp> : != <relational_expression> <equality_expression_temp>
+                        case 1: case 9: case 14: case 18: case 20: case 21: case 22: return 69; // <equality_expression_temp> : EPSILON
+                    }
+                    break;
+                case 83: // <init_declarator_temp>
+                    switch(token) {
+                        case 9: case 18: return 24; // <init_declarator_temp> : EPSILON
+                        case 14: return 25; // <init_declarator_temp> : = <initializer>
+                    }
+                    break;
+                case 84: // <parameter_list_temp>
+                    switch(token) {
+                        case 9: return 5; // <parameter_list_temp> : , <parameter> <parameter_list_temp>
+                        case 1: return 6; // <parameter_list_temp> : EPSILON
+                    }
+                    break;
+                case 85: // <additive_expression_temp>
+                    switch(token) {
+                        case 5: return 57; // <additive_expression_temp> : + <multiplicative_expression> <additive_expression_temp>
+                        case 6: return 58; // <additive_expression_temp> : - <multiplicative_expression> <additive_expression_temp>
+                        case 1: case 9: case 10: case 11: case 12: case 13: case 14: case 15: case 17: case 18: case 20: case 21: case 22: return 59; // <additive_expression_temp> : EPSILON
+                    }
+                    break;
+                case 86: // <selection_statement_temp>
+                    switch(token) {
+                        case 0: case 2: case 3: case 5: case 6: case 16: case 18: case 23: case 24: case 25: case 26: case 27: case 28: case 29: case 30: case 31: case 32: case 34: case 35: case 36: case 37: case 38: return 104; // <selection_statement_temp> : EPSILON
+                        case 33: return 105; // <selection_statement_temp> : else <statement>
+                    }
+                    break;
+                case 87: // <block_item_list_temp>
+                    switch(token) {
+                        case 3: return 96; // <block_item_list_temp> : EPSILON
+                        case 0: case 2: case 5: case 6: case 16: case 18: case 23: case 24: case 25: case 26: case 27: case 28: case 29: case 30: case 31: case 32: case 34: case 35: case 36: case 37: case 38: return 97; // <block_item_list_temp> : <block_item_list>
+                    }
+                    break;
+                case 88: // <parameter_list_question>
+                    switch(token) {
+                        case 9: case 34: case 36: case 37: case 38: return 9; // <parameter_list_question> : <parameter_list>
+                        case 1: return 10; // <parameter_list_question> : EPSILON
+                    }
+                    break;
+                case 89: // <argument_list_question>
+                    switch(token) {
+                        case 0: case 5: case 6: case 9: case 16: case 23: case 24: case 25: case 26: case 27: return 16; // <argument_list_question> : <argument_list>
+                        case 1: return 17; // <argument_list_question> : EPSILON
+                    }
+                    break;
+                case 90: // <func_decl>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 3; // <func_decl> : <type_specifier> identifier ( <parameter_list_question> ) <compound_statement>
+                    }
+                    break;
+                case 91: // <program_tail>
+                    switch(token) {
+                        case 34: case 36: case 37: case 38: return 1; // <program_tail> : <func_decl> <program_tail>
+                        case 39: return 2; // <program_tail> : EPSILON
+                    }
+                    break;
+                case 92: // <conditional_and_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 73; // <conditional_and_expression> : <equality_expression> <conditional_and_expression_temp>
+                    }
+                    break;
+                case 93: // <conditional_and_expression_temp>
+                    switch(token) {
+                        case 21: return 71; // <conditional_and_expression_temp> : && <equality_expression> <conditional_and_expression_temp>
+                        case 1: case 9: case 14: case 18: case 20: case 22: return 72; // <conditional_and_expression_temp> : EPSILON
+                    }
+                    break;
+                case 94: // <conditional_or_expression>
+                    switch(token) {
+                        case 0: case 5: case 6: case 16: case 23: case 24: case 25: case 26: case 27: return 76; // <conditional_or_expression> : <conditional_and_expression> <conditional_or_expression_temp>
+                    }
+                    break;
+                case 95: // <conditional_or_expression_temp>
+                    switch(token) {
+                        case 22: return 74; // <conditional_or_expression_temp> : || <conditional_and_expression> <conditional_or_expression_temp>
+                        case 1: case 9: case 14: case 18: case 20: return 75; // <conditional_or_expression_temp> : EPSILON
+                    }
+                    break;
+            }
+            return NO_RULE;
+        }
+
+        struct stack_entry {
+            symbol_id symbol;
+            node_id node;
+        };
+
+        string_view source;
+        vector<token_span> input_tokens;
+        size_t current_step{};
+        vector<stack_entry> stack_;
+        parsing_tree ast;
+        vs errors;
+
+        symbol_id token_type_at(size_t step) const {
+            return step < input_tokens.size() ? input_tokens[step].token_type : ENDMARKER;
+        }
+
+        bool is_complete() const {
+            return current_step == input_tokens.size() + 1 || stack_.back().symbol == ENDMARKER;
+        }
+
+        void jump() {
+            if(!is_complete()) {
+                current_step++;
+            }
+        }
+
+        void parser_next_step() {
+            symbol_id top_symbol = stack_.back().symbol;
+            bool top_is_non_terminal = top_symbol >= TERMINAL_COUNT;
+            uint32_t rule = NO_RULE;
+
+            while(!is_complete() && top_is_non_terminal &&
+                    (rule = select_rule(top_symbol, token_type_at(current_step))) == NO_RULE) {
+                errors.push_back("parser: error at symbol: " + string(NAMES[token_type_at(current_step)]));
+                jump();
+            }
+            if(is_complete()) {
+                return;
+            }
+
+            symbol_id current_type = token_type_at(current_step);
+            if(top_symbol == current_type) {
+                ast.set_token(stack_.back().node, input_tokens[current_step].value(source));
+                stack_.pop_back();
+                jump();
+            } else if(!top_is_non_terminal) {
+                errors.push_back("parser: error at symbol: " + string(NAMES[current_type]));
+                jump();
+            } else {
+                node_id parent_node = stack_.back().node;
+                stack_.pop_back();
+                // the kids of a node are added together, so they take one range
+                for(uint32_t no = RULE_BEGIN[rule]; no < RULE_BEGIN[rule + 1]; no++) {
+                    symbol_id entity = ENTITIES[no];
+                    ast.add_kid(parent_node, entity, NAMES[entity], entity >= TERMINAL_COUNT);
+                }
+                const node_id* kids = ast.kids(parent_node).begin();
+                for(uint32_t no = RULE_BEGIN[rule + 1]; no-- > RULE_BEGIN[rule];) {
+                    if(ENTITIES[no] != EPSILON_SYMBOL) {
+                        stack_.push_back({ENTITIES[no], kids[no - RULE_BEGIN[rule]]});
+                    }
+                }
+            }
+        }
+
+        public:
+
+        // symbols of the grammar, for the lexer and the bracket and .ast outputs
+        static const symbol_table& get_symbols() {
+            static const symbol_table symbols(
+                vs(begin(NAMES), begin(NAMES) + ENDMARKER),
+                vs(begin(NAMES) + TERMINAL_COUNT, begin(NAMES) + TERMINAL_COUNT + NON_TERMINAL_COUNT));
+            return symbols;
+        }
+
+        // spans into source, which must outlive the parser's use of the tree
+        void set_input(string_view source, vector<token_span> tokens) {
+            this->source = source;
+            input_tokens = std::move(tokens);
+        }
+
+        void parse() {
+            current_step = 0;
+            errors.clear();
+            ast.clear();
+            ast.reserve(input_tokens.size() * 4 + 1);
+            stack_.clear();
+            stack_.push_back({ENDMARKER, NO_NODE});
+            stack_.push_back({START_SYMBOL, ast.set_root(START_SYMBOL, NAMES[START_SYMBOL])});
+            while(!is_complete()) {
+                parser_next_step();
+            }
+        }
+
+        // see parser::emit()
+        bool emit(ostream* full, ostream* reduced, ostream* bracket, ostream* binary = nullptr) const {
+            return ast.emit(get_symbols(), source, full, reduced, bracket, binary);
+        }
+
+        const parsing_tree& get_tree() const {return ast;}
+
+        parsing_tree release_tree() {
+            return std::move(ast);
+        }
+
+        const vs& get_errors() const {return errors;}
+    };
+}